@@ -0,0 +1,347 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Gateway between managers speaking BER and a node using the compact encoding.
+ *
+ *         Usage: compact-gateway [-p port] node [node-port]
+ *                compact-gateway -x
+ *
+ *         SNMPv1 and SNMPv2c requests received on the port (1161 by default) are translated
+ *         to the compact encoding and sent to the node, its responses are translated back to
+ *         BER and returned to the manager which sent the request with the same request-id.
+ *         Other messages, SNMPv3 ones included, are forwarded as they are, the answers of
+ *         the node to them go to the manager which sent the last of them.
+ *
+ *         With -x hex encoded messages are read from the standard input one per line and
+ *         printed translated, a message which can't be translated is printed as "-".
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "ber.h"
+#include "compact.h"
+#include "utils.h"
+
+#define DEFAULT_PORT        1161
+#define DEFAULT_NODE_PORT   "161"
+
+/* a BER message takes several times the size of the compact one */
+#define GATEWAY_BUF_SIZE    4096
+
+/* the number of requests waiting for a response */
+#define PENDING_LEN         32
+
+/** \brief Manager waiting for the response to a translated request. */
+typedef struct {
+    s32t                    request_id;
+    struct sockaddr_storage addr;
+    socklen_t               addr_len;
+    u8t                     used;
+} pending_t;
+
+static pending_t pending[PENDING_LEN];
+static u8t next_pending = 0;
+
+/* the manager which sent the last message forwarded as it is */
+static struct sockaddr_storage raw_addr;
+static socklen_t raw_addr_len = 0;
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Translate a BER encoded request to the compact encoding.
+ */
+static s8t translate_request(const u8t* const input, const u16t len, u8t* output, u16t* output_start, u16t* output_len, s32t* request_id)
+{
+    message_t message;
+    ber_stream_t stream;
+    varbind_t* ptr;
+    s8t ret = -1;
+
+    memset(&message, 0, sizeof(message_t));
+    if (ber_decode_request(input, len, &message) == 0 &&
+            (message.version == SNMP_VERSION_1 || message.version == SNMP_VERSION_2C) &&
+            compact_stream_start(&stream, &message, message.pdu.request_type, output, GATEWAY_BUF_SIZE) == 0) {
+        for (ptr = message.pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+            if (compact_stream_append(&stream, ptr) != 0) {
+                break;
+            }
+        }
+        if (!ptr) {
+            compact_stream_finish(&stream);
+            *output_start = stream.start;
+            *output_len = stream.len;
+            *request_id = message.pdu.request_id;
+            ret = 0;
+        }
+    }
+    arena_reset();
+    return ret;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Translate a compact message to BER. The variable bindings are translated one by one,
+ * so a response is not limited by the number of the variable bindings of the arena.
+ */
+static s8t translate_response(const u8t* const input, const u16t len, u8t* output, u16t* output_start, u16t* output_len, s32t* request_id)
+{
+    message_t message;
+    ber_stream_t stream;
+    varbind_t varbind;
+    oid_t oid;
+    u16t pos, mark;
+    s8t ret = 0;
+
+    memset(&message, 0, sizeof(message_t));
+    if (compact_decode_header(input, len, &pos, &message) != 0 ||
+            ber_stream_start(&stream, &message, message.pdu.request_type, output, GATEWAY_BUF_SIZE) != 0) {
+        return -1;
+    }
+    memset(&varbind, 0, sizeof(varbind_t));
+    varbind.oid_ptr = &oid;
+    while (pos < len && ret == 0) {
+        mark = arena_mark();
+        ret = compact_decode_var_bind(input, len, &pos, &varbind);
+        if (ret == 0) {
+            ret = ber_stream_append(&stream, &varbind);
+        }
+        arena_release(mark);
+    }
+    if (ret != 0) {
+        return -1;
+    }
+    ber_stream_finish(&stream);
+    *output_start = stream.start;
+    *output_len = stream.len;
+    *request_id = message.pdu.request_id;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Translate hex encoded messages read from the standard input.
+ */
+static int translate_hex()
+{
+    static u8t input[GATEWAY_BUF_SIZE], output[GATEWAY_BUF_SIZE];
+    char line[2 * GATEWAY_BUF_SIZE + 2];
+    unsigned int byte;
+    u16t len, output_start, output_len, i;
+    s32t request_id;
+    s8t ret;
+    char* ptr;
+
+    while (fgets(line, sizeof(line), stdin)) {
+        len = 0;
+        for (ptr = line; len < GATEWAY_BUF_SIZE && sscanf(ptr, "%2x", &byte) == 1; ptr += 2) {
+            input[len++] = byte;
+        }
+        if (COMPACT_IS_MESSAGE(input, len)) {
+            ret = translate_response(input, len, output, &output_start, &output_len, &request_id);
+        } else {
+            ret = translate_request(input, len, output, &output_start, &output_len, &request_id);
+        }
+        if (ret != 0) {
+            printf("-\n");
+            continue;
+        }
+        for (i = 0; i < output_len; i++) {
+            printf("%02x", output[output_start + i]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Open the UDP socket of the managers, IPv4 managers are accepted as mapped addresses.
+ */
+static int open_manager_socket(u16t port)
+{
+    struct sockaddr_in6 addr;
+    int off = 0;
+    int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Open a UDP socket connected to the node.
+ */
+static int open_node_socket(const char* node, const char* port)
+{
+    struct addrinfo hints, *res, *ptr;
+    int sock = -1, err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    err = getaddrinfo(node, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", node, gai_strerror(err));
+        return -1;
+    }
+    for (ptr = res; ptr; ptr = ptr->ai_next) {
+        sock = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+        if (sock == -1) {
+            continue;
+        }
+        if (connect(sock, ptr->ai_addr, ptr->ai_addrlen) == 0) {
+            break;
+        }
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock == -1) {
+        fprintf(stderr, "%s: can not connect\n", node);
+    }
+    return sock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Forward a message of a manager to the node.
+ */
+static void from_manager(int manager_sock, int node_sock)
+{
+    static u8t input[GATEWAY_BUF_SIZE], output[GATEWAY_BUF_SIZE];
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    u16t output_start, output_len;
+    s32t request_id;
+    ssize_t len;
+
+    len = recvfrom(manager_sock, input, sizeof(input), 0, (struct sockaddr*)&addr, &addr_len);
+    if (len <= 0) {
+        return;
+    }
+    if (translate_request(input, len, output, &output_start, &output_len, &request_id) == 0) {
+        /* the oldest pending request is forgotten if there is no free place */
+        pending[next_pending].request_id = request_id;
+        pending[next_pending].addr = addr;
+        pending[next_pending].addr_len = addr_len;
+        pending[next_pending].used = 1;
+        next_pending = (next_pending + 1) % PENDING_LEN;
+        send(node_sock, output + output_start, output_len, 0);
+    } else {
+        raw_addr = addr;
+        raw_addr_len = addr_len;
+        send(node_sock, input, len, 0);
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Return a message of the node to the manager waiting for it.
+ */
+static void from_node(int node_sock, int manager_sock)
+{
+    static u8t input[GATEWAY_BUF_SIZE], output[GATEWAY_BUF_SIZE];
+    u16t output_start, output_len;
+    s32t request_id;
+    ssize_t len;
+    u8t i;
+
+    len = recv(node_sock, input, sizeof(input), 0);
+    if (len <= 0) {
+        return;
+    }
+    if (!COMPACT_IS_MESSAGE(input, len)) {
+        if (raw_addr_len) {
+            sendto(manager_sock, input, len, 0, (struct sockaddr*)&raw_addr, raw_addr_len);
+        }
+        return;
+    }
+    if (translate_response(input, len, output, &output_start, &output_len, &request_id) != 0) {
+        fprintf(stderr, "can not translate a message of the node\n");
+        return;
+    }
+    for (i = 0; i < PENDING_LEN; i++) {
+        if (pending[i].used && pending[i].request_id == request_id) {
+            pending[i].used = 0;
+            sendto(manager_sock, output + output_start, output_len, 0, (struct sockaddr*)&pending[i].addr, pending[i].addr_len);
+            return;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    struct pollfd fds[2];
+    u16t port = DEFAULT_PORT;
+    int i = 1;
+
+    if (argc == 2 && !strcmp(argv[1], "-x")) {
+        return translate_hex();
+    }
+    if (argc > 2 && !strcmp(argv[1], "-p")) {
+        port = atoi(argv[2]);
+        i = 3;
+    }
+    if (i >= argc || i + 2 < argc) {
+        fprintf(stderr, "usage: %s [-p port] node [node-port]\n       %s -x\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    fds[0].fd = open_manager_socket(port);
+    fds[1].fd = open_node_socket(argv[i], i + 1 < argc ? argv[i + 1] : DEFAULT_NODE_PORT);
+    if (fds[0].fd == -1 || fds[1].fd == -1) {
+        return 1;
+    }
+    fds[0].events = fds[1].events = POLLIN;
+    while (poll(fds, 2, -1) > 0) {
+        if (fds[0].revents & POLLIN) {
+            from_manager(fds[0].fd, fds[1].fd);
+        }
+        if (fds[1].revents & POLLIN) {
+            from_node(fds[1].fd, fds[0].fd);
+        }
+    }
+    perror("poll");
+    return 1;
+}
@@ -0,0 +1,339 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Microbenchmark of the agent core on the host.
+ *
+ *         Usage: snmp-bench [-n iterations] file.in ...
+ *
+ *         Every input file contains the OIDs of a request in the format used by
+ *         the tests in the test directory. For each of them GET and GETNEXT requests are
+ *         built and the decoder, the MIB lookup, the encoder and the whole
+ *         request handler are timed, followed by a GETNEXT walk of the whole
+ *         MIB. The number of heap allocations is counted
+ *         by wrapping malloc (link with -Wl,--wrap=malloc).
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "snmp-protocol.h"
+#include "ber.h"
+#include "mib.h"
+#include "mib-init.h"
+#include "utils.h"
+
+#define DEFAULT_ITERATIONS 100000
+
+/* the number of heap allocations */
+static unsigned long allocations = 0;
+
+void* __real_malloc(size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+/** \brief Symbolic names used in the test inputs. */
+static const struct {
+    const char* name;
+    const char* oid;
+} names[] = {
+    {"sysdescr", "1.3.6.1.2.1.1.1.0"},
+    {"sysuptime", "1.3.6.1.2.1.1.3.0"},
+    {"sysname", "1.3.6.1.2.1.1.5.0"},
+    {0, 0}
+};
+
+/** \brief Timed operation. */
+typedef void (*operation_t)(void* arg);
+
+/** \brief Request and its decoded form. */
+typedef struct {
+    u8t         data[MAX_BUF_SIZE];
+    u16t        len;
+    message_t   message;
+} request_t;
+
+static u8t output[MAX_BUF_SIZE];
+static u16t output_start, output_len;
+static long iterations = DEFAULT_ITERATIONS;
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a BER encoded type and length.
+ */
+static u8t* put_type_length(u8t* ptr, u8t type, u16t len)
+{
+    *ptr++ = type;
+    if (len > 0xFF) {
+        *ptr++ = 0x82;
+        *ptr++ = len >> 8;
+    } else if (len > 0x7F) {
+        *ptr++ = 0x81;
+    }
+    *ptr++ = len & 0xFF;
+    return ptr;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a BER encoded OID given in the dotted notation.
+ */
+static u8t* put_oid(u8t* ptr, const char* str)
+{
+    u8t value[OID_LEN * 5];
+    unsigned long el[OID_LEN] = {0};
+    u16t len = 0;
+    int n = 0, i, j;
+    char* end;
+
+    while (*str && n < OID_LEN) {
+        if (*str == '.') {
+            str++;
+        }
+        el[n++] = strtoul(str, &end, 10);
+        str = end;
+    }
+    value[len++] = el[0] * 40 + (n > 1 ? el[1] : 0);
+    for (i = 2; i < n; i++) {
+        for (j = 4; j > 0; j--) {
+            if (el[i] >> (7 * j)) {
+                value[len++] = ((el[i] >> (7 * j)) & 0x7F) | 0x80;
+            }
+        }
+        value[len++] = el[i] & 0x7F;
+    }
+    ptr = put_type_length(ptr, BER_TYPE_OID, len);
+    memcpy(ptr, value, len);
+    return ptr + len;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Build an SNMPv1 request for the OIDs listed in the file.
+ */
+static s8t build_request(request_t* request, const char* file_name, u8t type)
+{
+    u8t varbinds[MAX_BUF_SIZE], pdu[MAX_BUF_SIZE];
+    u8t *ptr = varbinds, *vb_ptr;
+    char word[128];
+    const char* oid;
+    u16t len;
+    int i;
+    FILE* file = fopen(file_name, "r");
+    if (!file) {
+        perror(file_name);
+        return -1;
+    }
+    while (fscanf(file, "%127s", word) == 1) {
+        oid = word;
+        for (i = 0; names[i].name; i++) {
+            if (!strcmp(names[i].name, word)) {
+                oid = names[i].oid;
+            }
+        }
+        vb_ptr = put_oid(ptr + 2, oid);
+        *vb_ptr++ = BER_TYPE_NULL;
+        *vb_ptr++ = 0;
+        put_type_length(ptr, BER_TYPE_SEQUENCE, vb_ptr - ptr - 2);
+        ptr = vb_ptr;
+    }
+    fclose(file);
+    len = ptr - varbinds;
+
+    /* request id, error status and error index followed by the variable bindings */
+    ptr = pdu;
+    memcpy(ptr, "\x02\x01\x2a\x02\x01\x00\x02\x01\x00", 9);
+    ptr = put_type_length(ptr + 9, BER_TYPE_SEQUENCE, len);
+    memcpy(ptr, varbinds, len);
+    len = ptr + len - pdu;
+
+    ptr = put_type_length(request->data, BER_TYPE_SEQUENCE, 0);
+    ptr = request->data + 4;
+    memcpy(ptr, "\x02\x01\x00\x04\x06public", 11);
+    ptr = put_type_length(ptr + 11, type, len);
+    memcpy(ptr, pdu, len);
+    ptr += len;
+
+    /* the message length is known only now */
+    len = ptr - request->data - 4;
+    request->data[0] = BER_TYPE_SEQUENCE;
+    request->data[1] = 0x82;
+    request->data[2] = len >> 8;
+    request->data[3] = len & 0xFF;
+    request->len = ptr - request->data;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Timed operations.
+ */
+static void op_decode(void* arg)
+{
+    request_t* request = (request_t*)arg;
+    ber_decode_request(request->data, request->len, &request->message);
+    arena_reset();
+}
+
+static void op_encode(void* arg)
+{
+    request_t* request = (request_t*)arg;
+    ber_encode_response(&request->message, output, &output_len, request->data, request->len, MAX_BUF_SIZE);
+}
+
+static void op_mib_get(void* arg)
+{
+    request_t* request = (request_t*)arg;
+    varbind_t* ptr;
+    for (ptr = request->message.pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+        mib_get(ptr);
+    }
+}
+
+static void op_mib_get_next(void* arg)
+{
+    request_t* request = (request_t*)arg;
+    varbind_t* ptr;
+    oid_t oid;
+    for (ptr = request->message.pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+        /* mib_get_next replaces the oid with the next one */
+        oid_copy(&oid, ptr->oid_ptr);
+        mib_get_next(ptr);
+        oid_copy(ptr->oid_ptr, &oid);
+    }
+}
+
+static void op_walk(void* arg)
+{
+    oid_t oid;
+    varbind_t varbind;
+    memset(&varbind, 0, sizeof(varbind_t));
+    /* GETNEXT from iso.org until the end of the MIB */
+    oid.values[0] = 1;
+    oid.values[1] = 3;
+    oid.len = 2;
+    varbind.oid_ptr = &oid;
+    while (mib_get_next(&varbind));
+}
+
+static void op_handler(void* arg)
+{
+    request_t* request = (request_t*)arg;
+    snmp_handler(request->data, request->len, output, &output_start, &output_len, MAX_BUF_SIZE);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Run an operation and report the time and the number of heap allocations per call.
+ */
+static void run(const char* name, const char* shape, operation_t op, void* arg)
+{
+    struct timespec start, end;
+    unsigned long allocs;
+    double ns;
+    long i;
+
+    /* warm up */
+    op(arg);
+
+    allocs = allocations;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < iterations; i++) {
+        op(arg);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    allocs = allocations - allocs;
+
+    ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%-20s %-16s %10.1f %10.2f\n", name, shape, ns / iterations, (double)allocs / iterations);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Benchmark a GET and a GETNEXT request built from the file.
+ */
+static void bench_file(const char* file_name)
+{
+    static request_t get, get_next;
+    char shape[64];
+    const char* base = strrchr(file_name, '/');
+    base = base ? base + 1 : file_name;
+
+    if (build_request(&get, file_name, BER_TYPE_SNMP_GET) == -1 ||
+            build_request(&get_next, file_name, BER_TYPE_SNMP_GETNEXT) == -1) {
+        return;
+    }
+
+    snprintf(shape, sizeof(shape), "%s", base);
+    run("ber_decode_request", shape, &op_decode, &get);
+
+    /* the decoded request stays in the arena while its lookups are timed */
+    if (ber_decode_request(get.data, get.len, &get.message) != 0) {
+        printf("%-20s %-16s request does not fit into the arena\n", "decode", shape);
+        arena_reset();
+        return;
+    }
+    run("mib_get", shape, &op_mib_get, &get);
+    run("ber_encode_response", shape, &op_encode, &get);
+    arena_reset();
+
+    ber_decode_request(get_next.data, get_next.len, &get_next.message);
+    run("mib_get_next", shape, &op_mib_get_next, &get_next);
+    arena_reset();
+
+    snprintf(shape, sizeof(shape), "%s GET", base);
+    run("snmp_handler", shape, &op_handler, &get);
+    snprintf(shape, sizeof(shape), "%s GETNEXT", base);
+    run("snmp_handler", shape, &op_handler, &get_next);
+}
+
+int main(int argc, char** argv)
+{
+    int i = 1;
+    if (argc > 2 && !strcmp(argv[1], "-n")) {
+        iterations = atol(argv[2]);
+        i = 3;
+    }
+    if (i >= argc || iterations <= 0) {
+        fprintf(stderr, "usage: %s [-n iterations] file.in ...\n", argv[0]);
+        return 1;
+    }
+    if (mib_init() == -1) {
+        fprintf(stderr, "error occurs while initializing the MIB\n");
+        return 1;
+    }
+
+    printf("%-20s %-16s %10s %10s\n", "operation", "request", "ns/op", "allocs/op");
+    for (; i < argc; i++) {
+        bench_file(argv[i]);
+    }
+    run("mib_get_next", "walk of the MIB", &op_walk, 0);
+    return 0;
+}
@@ -0,0 +1,634 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Caching proxy of the agents of the motes for the border router.
+ *
+ *         Usage: snmp-proxy [-c community] [-t [oid=]seconds]... port=mote[/mote-port]...
+ *
+ *         Every registered mote is served on its own local port. SNMPv1 and SNMPv2c GET and
+ *         GETNEXT requests with the community of the proxy are answered from a cache of the
+ *         variable bindings returned by the mote, so the manager sees the latency of the LAN
+ *         instead of the one of the mesh. The time to live of the cached values is given for
+ *         OID prefixes by -t (60 seconds by default, the values of a prefix with 0 are not
+ *         cached), an entry older than its time to live is still served, but refreshed in the
+ *         background by the proxy, and an entry older than twice its time to live is not
+ *         served any more. Requests which are not answered from
+ *         the cache are forwarded to the mote and its responses fill the cache. Other
+ *         requests are forwarded as they are, a SET request clears the cache of the mote.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "ber.h"
+#include "utils.h"
+
+#define DEFAULT_TTL         60
+
+/* the time in seconds a mote has to answer a refresh before it is sent again */
+#define REFRESH_TIMEOUT     5
+
+#define MOTES_LEN           8
+#define CACHE_LEN           64
+#define PENDING_LEN         32
+#define TTLS_LEN            8
+
+/* the longest cached octet string */
+#define VALUE_LEN           64
+
+/* a response to a request taking the whole buffer may take several times its size */
+#define PROXY_BUF_SIZE      1500
+
+/** \brief Cached variable binding returned by a mote. */
+typedef struct {
+    /* BER_TYPE_SNMP_GET or BER_TYPE_SNMP_GETNEXT, 0 if the entry is free */
+    u8t             request_type;
+    /* the OID of the request and the one of the response, they differ for GETNEXT */
+    oid_t           oid;
+    oid_t           response_oid;
+    u8t             value_type;
+    varbind_value_t value;
+    u8t             data[VALUE_LEN];
+    oid_t           oid_value;
+    u64t            u64_value;
+    time_t          fetched;
+    time_t          refreshed;
+} cache_entry_t;
+
+/** \brief Registered mote. */
+typedef struct {
+    int             manager_sock;
+    int             mote_sock;
+    cache_entry_t   cache[CACHE_LEN];
+    /* the manager which sent the last request forwarded as it is without a request-id */
+    struct sockaddr_storage raw_addr;
+    socklen_t       raw_addr_len;
+} mote_t;
+
+/** \brief Request sent to a mote waiting for its response. */
+typedef struct {
+    mote_t*         mote;
+    /* the request-id of the request sent to the mote */
+    s32t            request_id;
+    /* the request-id of the manager */
+    s32t            manager_request_id;
+    /* the type of a request which response is cached, 0 for a request forwarded as it is */
+    u8t             request_type;
+    oid_t           oids[VAR_BIND_LEN];
+    u8t             oids_len;
+    /* the manager, none for a refresh */
+    struct sockaddr_storage addr;
+    socklen_t       addr_len;
+    u8t             used;
+} pending_t;
+
+/** \brief Time to live of the values under an OID prefix. */
+typedef struct {
+    oid_t           prefix;
+    time_t          ttl;
+} ttl_t;
+
+static mote_t motes[MOTES_LEN];
+static u8t motes_len = 0;
+
+static pending_t pending[PENDING_LEN];
+static u8t next_pending = 0;
+
+static ttl_t ttls[TTLS_LEN];
+static u8t ttls_len = 0;
+static time_t default_ttl = DEFAULT_TTL;
+
+static const char* community = COMMUNITY_STRING;
+
+/* request-ids of the requests of the proxy */
+static s32t next_request_id = 0x40000000;
+
+static u8t output[PROXY_BUF_SIZE];
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of seconds since an arbitrary point.
+ */
+static time_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse an OID in the dotted notation.
+ */
+static s8t parse_oid(const char* str, oid_t* oid)
+{
+    char* end;
+    oid->len = 0;
+    while (*str) {
+        if (oid->len == OID_LEN) {
+            return -1;
+        }
+        oid->values[oid->len++] = strtoul(str, &end, 10);
+        if (end == str || (*end && *end != '.')) {
+            return -1;
+        }
+        str = *end ? end + 1 : end;
+    }
+    return oid->len >= 2 ? 0 : -1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the time to live of the value of the OID, the longest matching prefix counts.
+ */
+static time_t ttl_of(const oid_t* const oid)
+{
+    time_t ttl = default_ttl;
+    u8t i, best_len = 0;
+    for (i = 0; i < ttls_len; i++) {
+        if (ttls[i].prefix.len > best_len && oid_starts_with(oid, &ttls[i].prefix)) {
+            ttl = ttls[i].ttl;
+            best_len = ttls[i].prefix.len;
+        }
+    }
+    return ttl;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find the cache entry of a request.
+ */
+static cache_entry_t* cache_find(mote_t* mote, const u8t request_type, const oid_t* const oid)
+{
+    u8t i;
+    for (i = 0; i < CACHE_LEN; i++) {
+        if (mote->cache[i].request_type == request_type && !oid_cmp(&mote->cache[i].oid, oid)) {
+            return &mote->cache[i];
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Store a variable binding returned by the mote, the least recently fetched entry is replaced.
+ */
+static void cache_store(mote_t* mote, const u8t request_type, const oid_t* const oid, const varbind_t* const varbind)
+{
+    cache_entry_t* entry = cache_find(mote, request_type, oid);
+    u8t i;
+    if (varbind->value_type == BER_TYPE_OCTET_STRING && varbind->value.s_value.len > VALUE_LEN) {
+        return;
+    }
+    if (!entry) {
+        entry = &mote->cache[0];
+        for (i = 1; i < CACHE_LEN && entry->request_type; i++) {
+            if (!mote->cache[i].request_type || mote->cache[i].fetched < entry->fetched) {
+                entry = &mote->cache[i];
+            }
+        }
+    }
+    entry->request_type = request_type;
+    oid_copy(&entry->oid, oid);
+    oid_copy(&entry->response_oid, varbind->oid_ptr);
+    entry->value_type = varbind->value_type;
+    entry->value = varbind->value;
+    if (varbind->value_type == BER_TYPE_OCTET_STRING) {
+        memcpy(entry->data, varbind->value.s_value.ptr, varbind->value.s_value.len);
+    } else if (varbind->value_type == BER_TYPE_OID) {
+        oid_copy(&entry->oid_value, varbind->value.oid_value);
+    } else if (varbind->value_type == BER_TYPE_COUNTER64) {
+        entry->u64_value = *varbind->value.u64_value;
+    }
+    entry->fetched = now();
+    entry->refreshed = 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Fill in a variable binding of a response from the cache entry.
+ */
+static void cache_load(cache_entry_t* entry, varbind_t* varbind)
+{
+    oid_copy(varbind->oid_ptr, &entry->response_oid);
+    varbind->value_type = entry->value_type;
+    varbind->value = entry->value;
+    varbind->encoded_ptr = 0;
+    if (entry->value_type == BER_TYPE_OCTET_STRING) {
+        varbind->value.s_value.ptr = entry->data;
+    } else if (entry->value_type == BER_TYPE_OID) {
+        varbind->value.oid_value = &entry->oid_value;
+    } else if (entry->value_type == BER_TYPE_COUNTER64) {
+        varbind->value.u64_value = &entry->u64_value;
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Take a free place for a request sent to a mote, the oldest one is forgotten if there is none.
+ */
+static pending_t* pending_new(mote_t* mote, const s32t request_id)
+{
+    pending_t* ptr = &pending[next_pending];
+    next_pending = (next_pending + 1) % PENDING_LEN;
+    memset(ptr, 0, sizeof(pending_t));
+    ptr->mote = mote;
+    ptr->request_id = request_id;
+    ptr->used = 1;
+    return ptr;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encode the message as a request of its type and send it to the mote.
+ */
+static void send_request(mote_t* mote, message_t* message)
+{
+    ber_stream_t stream;
+    varbind_t* ptr;
+    if (ber_stream_start(&stream, message, message->pdu.request_type, output, PROXY_BUF_SIZE) == -1) {
+        return;
+    }
+    for (ptr = message->pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+        if (ber_stream_append(&stream, ptr) == -1) {
+            return;
+        }
+    }
+    ber_stream_finish(&stream);
+    send(mote->mote_sock, output + stream.start, stream.len, 0);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Refresh a cache entry in the background.
+ */
+static void refresh(mote_t* mote, cache_entry_t* entry)
+{
+    message_t message;
+    varbind_t varbind;
+    pending_t* ptr;
+
+    memset(&message, 0, sizeof(message_t));
+    memset(&varbind, 0, sizeof(varbind_t));
+    message.version = SNMP_VERSION_2C;
+    message.community = (u8t*)community;
+    message.community_len = strlen(community);
+    message.pdu.request_type = entry->request_type;
+    message.pdu.request_id = next_request_id++;
+    message.pdu.varbind_first_ptr = &varbind;
+    varbind.oid_ptr = &entry->oid;
+    varbind.value_type = BER_TYPE_NULL;
+
+    ptr = pending_new(mote, message.pdu.request_id);
+    ptr->request_type = entry->request_type;
+    oid_copy(&ptr->oids[0], &entry->oid);
+    ptr->oids_len = 1;
+    entry->refreshed = now();
+    send_request(mote, &message);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Answer the request from the cache if all its variable bindings are there.
+ */
+static s8t answer_from_cache(mote_t* mote, message_t* message, const u8t* const input, const u16t len,
+        const struct sockaddr_storage* addr, const socklen_t addr_len)
+{
+    cache_entry_t* entries[VAR_BIND_LEN];
+    varbind_t* ptr;
+    time_t age, ttl, t = now();
+    u16t output_len;
+    u8t i = 0;
+
+    for (ptr = message->pdu.varbind_first_ptr; ptr && i < VAR_BIND_LEN; ptr = ptr->next_ptr, i++) {
+        entries[i] = cache_find(mote, message->pdu.request_type, ptr->oid_ptr);
+        if (!entries[i]) {
+            return -1;
+        }
+        /* the exceptions are not defined in SNMPv1 */
+        if (message->version == SNMP_VERSION_1 && (entries[i]->value_type == BER_TYPE_NO_SUCH_OBJECT ||
+                entries[i]->value_type == BER_TYPE_NO_SUCH_INSTANCE || entries[i]->value_type == BER_TYPE_END_OF_MIB_VIEW)) {
+            return -1;
+        }
+        /* a time to live of 0 turns the caching off */
+        ttl = ttl_of(&entries[i]->oid);
+        if (!ttl || t - entries[i]->fetched > 2 * ttl) {
+            return -1;
+        }
+    }
+    if (ptr) {
+        return -1;
+    }
+
+    for (ptr = message->pdu.varbind_first_ptr, i = 0; ptr && i < VAR_BIND_LEN; ptr = ptr->next_ptr, i++) {
+        age = t - entries[i]->fetched;
+        ttl = ttl_of(&entries[i]->oid);
+        if (age > ttl && t - entries[i]->refreshed > REFRESH_TIMEOUT) {
+            refresh(mote, entries[i]);
+        }
+        cache_load(entries[i], ptr);
+    }
+    if (ber_encode_response(message, output, &output_len, input, len, PROXY_BUF_SIZE) == -1) {
+        return -1;
+    }
+    sendto(mote->manager_sock, output, output_len, 0, (struct sockaddr*)addr, addr_len);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle a request of a manager.
+ */
+static void from_manager(mote_t* mote)
+{
+    static u8t input[PROXY_BUF_SIZE];
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    message_t message;
+    pending_t* pend;
+    varbind_t* ptr;
+    ssize_t len;
+    u8t cached, i;
+
+    len = recvfrom(mote->manager_sock, input, sizeof(input), 0, (struct sockaddr*)&addr, &addr_len);
+    if (len <= 0) {
+        return;
+    }
+    memset(&message, 0, sizeof(message_t));
+    if (ber_decode_request(input, len, &message) != 0 ||
+            (message.version != SNMP_VERSION_1 && message.version != SNMP_VERSION_2C)) {
+        /* the response is matched by the order of the requests */
+        mote->raw_addr = addr;
+        mote->raw_addr_len = addr_len;
+        send(mote->mote_sock, input, len, 0);
+        arena_reset();
+        return;
+    }
+
+    /* a request with more variable bindings than a pending request keeps is forwarded as it is */
+    cached = (message.pdu.request_type == BER_TYPE_SNMP_GET || message.pdu.request_type == BER_TYPE_SNMP_GETNEXT) &&
+            message.pdu.varbind_len <= VAR_BIND_LEN &&
+            message.community_len == strlen(community) && !memcmp(message.community, community, message.community_len);
+    if (cached && answer_from_cache(mote, &message, input, len, &addr, addr_len) == 0) {
+        arena_reset();
+        return;
+    }
+
+    if (message.pdu.request_type == BER_TYPE_SNMP_SET) {
+        memset(mote->cache, 0, sizeof(mote->cache));
+    }
+    if (!cached) {
+        /* forwarded as it is, the response is matched by the request-id of the manager */
+        pend = pending_new(mote, message.pdu.request_id);
+        pend->manager_request_id = message.pdu.request_id;
+        send(mote->mote_sock, input, len, 0);
+    } else {
+        /* a miss is forwarded under a request-id of the proxy, so it does not clash with the refreshes */
+        pend = pending_new(mote, next_request_id);
+        pend->request_type = message.pdu.request_type;
+        for (ptr = message.pdu.varbind_first_ptr, i = 0; ptr && i < VAR_BIND_LEN; ptr = ptr->next_ptr, i++) {
+            oid_copy(&pend->oids[i], ptr->oid_ptr);
+        }
+        pend->oids_len = i;
+        pend->manager_request_id = message.pdu.request_id;
+        message.pdu.request_id = next_request_id++;
+        send_request(mote, &message);
+    }
+    pend->addr = addr;
+    pend->addr_len = addr_len;
+    arena_reset();
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle a response of a mote.
+ */
+static void from_mote(mote_t* mote)
+{
+    static u8t input[PROXY_BUF_SIZE];
+    message_t message;
+    pending_t* pend = 0;
+    varbind_t* ptr;
+    u16t output_len;
+    ssize_t len;
+    u8t i;
+
+    len = recv(mote->mote_sock, input, sizeof(input), 0);
+    if (len <= 0) {
+        return;
+    }
+    memset(&message, 0, sizeof(message_t));
+    if (ber_decode_request(input, len, &message) != 0 ||
+            (message.version != SNMP_VERSION_1 && message.version != SNMP_VERSION_2C)) {
+        if (mote->raw_addr_len) {
+            sendto(mote->manager_sock, input, len, 0, (struct sockaddr*)&mote->raw_addr, mote->raw_addr_len);
+        }
+        arena_reset();
+        return;
+    }
+    for (i = 0; i < PENDING_LEN && !pend; i++) {
+        if (pending[i].used && pending[i].mote == mote && pending[i].request_id == message.pdu.request_id) {
+            pend = &pending[i];
+        }
+    }
+    if (!pend) {
+        arena_reset();
+        return;
+    }
+    pend->used = 0;
+
+    if (!pend->request_type) {
+        sendto(mote->manager_sock, input, len, 0, (struct sockaddr*)&pend->addr, pend->addr_len);
+        arena_reset();
+        return;
+    }
+    if (message.pdu.error_status == ERROR_STATUS_NO_ERROR) {
+        for (ptr = message.pdu.varbind_first_ptr, i = 0; ptr && i < pend->oids_len; ptr = ptr->next_ptr, i++) {
+            cache_store(mote, pend->request_type, &pend->oids[i], ptr);
+        }
+    }
+    if (pend->addr_len) {
+        message.pdu.request_id = pend->manager_request_id;
+        if (ber_encode_response(&message, output, &output_len, input, len, PROXY_BUF_SIZE) == 0) {
+            sendto(mote->manager_sock, output, output_len, 0, (struct sockaddr*)&pend->addr, pend->addr_len);
+        }
+    }
+    arena_reset();
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Open the UDP socket the managers reach the mote at, IPv4 managers are accepted as mapped addresses.
+ */
+static int open_manager_socket(u16t port)
+{
+    struct sockaddr_in6 addr;
+    int off = 0;
+    int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Open a UDP socket connected to the mote.
+ */
+static int open_mote_socket(const char* node, const char* port)
+{
+    struct addrinfo hints, *res, *ptr;
+    int sock = -1, err;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    err = getaddrinfo(node, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", node, gai_strerror(err));
+        return -1;
+    }
+    for (ptr = res; ptr; ptr = ptr->ai_next) {
+        sock = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+        if (sock == -1) {
+            continue;
+        }
+        if (connect(sock, ptr->ai_addr, ptr->ai_addrlen) == 0) {
+            break;
+        }
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock == -1) {
+        fprintf(stderr, "%s: can not connect\n", node);
+    }
+    return sock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Register a mote given as port=mote[/mote-port].
+ */
+static s8t register_mote(char* arg)
+{
+    char* node = strchr(arg, '=');
+    char* port;
+    mote_t* mote = &motes[motes_len];
+    if (!node || motes_len == MOTES_LEN) {
+        return -1;
+    }
+    *node++ = 0;
+    port = strchr(node, '/');
+    if (port) {
+        *port++ = 0;
+    }
+    mote->manager_sock = open_manager_socket(atoi(arg));
+    mote->mote_sock = open_mote_socket(node, port ? port : "161");
+    if (mote->manager_sock == -1 || mote->mote_sock == -1) {
+        return -1;
+    }
+    motes_len++;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the time to live given as [oid=]seconds.
+ */
+static s8t set_ttl(char* arg)
+{
+    char* value = strchr(arg, '=');
+    if (!value) {
+        default_ttl = atol(arg);
+        return 0;
+    }
+    *value++ = 0;
+    if (ttls_len == TTLS_LEN || parse_oid(arg, &ttls[ttls_len].prefix) == -1) {
+        return -1;
+    }
+    ttls[ttls_len++].ttl = atol(value);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    struct pollfd fds[2 * MOTES_LEN];
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            community = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            if (set_ttl(argv[++i]) == -1) {
+                fprintf(stderr, "bad time to live %s\n", argv[i]);
+                return 1;
+            }
+        } else if (register_mote(argv[i]) == -1) {
+            fprintf(stderr, "can not register the mote %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!motes_len) {
+        fprintf(stderr, "usage: %s [-c community] [-t [oid=]seconds]... port=mote[/mote-port]...\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < motes_len; i++) {
+        fds[2 * i].fd = motes[i].manager_sock;
+        fds[2 * i + 1].fd = motes[i].mote_sock;
+        fds[2 * i].events = fds[2 * i + 1].events = POLLIN;
+    }
+    while (poll(fds, 2 * motes_len, -1) > 0) {
+        for (i = 0; i < motes_len; i++) {
+            if (fds[2 * i].revents & POLLIN) {
+                from_manager(&motes[i]);
+            }
+            if (fds[2 * i + 1].revents & POLLIN) {
+                from_mote(&motes[i]);
+            }
+        }
+    }
+    perror("poll");
+    return 1;
+}
@@ -0,0 +1,330 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Linux UDP transport of the agent for border routers and gateway hosts.
+ *
+ *         Usage: snmpd-linux [-p port] [-t trace-file] [-i manager[/port]]
+ *
+ *         The requests are received on an IPv6 socket (IPv4 managers are accepted as mapped
+ *         addresses, the port is 161 by default) in batches by recvmmsg, each batch is
+ *         handled by the agent core and its responses are sent back by a single sendmmsg,
+ *         so a polling storm takes two system calls per batch instead of two per request.
+ *         The trace records of the log points are appended to the trace file after each
+ *         batch, tools/tracedump.py decodes them.
+ *         Given a manager (an IPv6 address, the port is 162 by default), the agent sends it
+ *         a coldStart Inform when it starts and retransmits it until it is acknowledged.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "transport.h"
+#include "mib-init.h"
+#include "usm.h"
+#include "notification.h"
+#include "stats.h"
+#include "logging.h"
+
+#define DEFAULT_PORT    161
+
+#define NOTIFICATION_PORT   162
+
+/* time in milliseconds before the first retransmission of an Inform, doubled after each one */
+#define INFORM_TIMEOUT_MS   1000
+
+/* the number of datagrams received or sent by a system call */
+#define BATCH_LEN       32
+
+/** \brief Datagrams of a batch. */
+typedef struct {
+    struct mmsghdr          msgs[BATCH_LEN];
+    struct iovec            iovecs[BATCH_LEN];
+    struct sockaddr_in6     addrs[BATCH_LEN];
+    u8t                     buffers[BATCH_LEN][MAX_BUF_SIZE];
+} batch_t;
+
+static batch_t requests, responses;
+
+/* file the trace records are appended to */
+static FILE* trace_file = NULL;
+
+/* the socket of the agent, the notifications are sent from it to the manager */
+static int sock = -1;
+static struct sockaddr_in6 manager;
+
+static const oid_t cold_start_oid = {{1, 3, 6, 1, 6, 3, 1, 1, 5, 1}, 10};
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of seconds since the start of the agent.
+ */
+static u32t uptime()
+{
+    static struct timespec start;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!start.tv_sec && !start.tv_nsec) {
+        start = now;
+    }
+    return now.tv_sec - start.tv_sec;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Clock of the Informs in milliseconds, it wraps around like the clock of the mote.
+ */
+static u16t inform_clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u16t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+#if ENABLE_AGENT_STATS
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Clock of the statistics in nanoseconds.
+ */
+static u32t stats_clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+#endif /* ENABLE_AGENT_STATS */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Open the UDP socket of the agent.
+ */
+static int open_socket(u16t port)
+{
+    struct sockaddr_in6 addr;
+    int off = 0;
+    int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the manager of the notifications given as address[/port].
+ */
+static s8t set_manager(char* arg)
+{
+    char* port = strchr(arg, '/');
+    if (port) {
+        *port++ = 0;
+    }
+    memset(&manager, 0, sizeof(manager));
+    manager.sin6_family = AF_INET6;
+    manager.sin6_port = htons(port ? atoi(port) : NOTIFICATION_PORT);
+    return inet_pton(AF_INET6, arg, &manager.sin6_addr) == 1 ? 0 : -1;
+}
+
+static void notification_send(const u8t* data, u16t len)
+{
+    sendto(sock, data, len, 0, (struct sockaddr*)&manager, sizeof(manager));
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Retransmit the Informs which are due, returns the time in milliseconds until the next
+ * retransmission or -1 if no Inform waits for an acknowledgement.
+ */
+static int inform_wait()
+{
+    u16t now = inform_clock(), next;
+    if (!inform_poll(now, &next)) {
+        return -1;
+    }
+    return (s16t)(next - now) > 0 ? (s16t)(next - now) : 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Point the headers of the batch to its buffers, every datagram may take the whole buffer.
+ */
+static void batch_reset(batch_t* batch)
+{
+    u8t i;
+    memset(batch->msgs, 0, sizeof(batch->msgs));
+    for (i = 0; i < BATCH_LEN; i++) {
+        batch->iovecs[i].iov_base = batch->buffers[i];
+        batch->iovecs[i].iov_len = MAX_BUF_SIZE;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle the received requests and collect the responses, the requests which
+ * are not answered leave no gap in the responses.
+ */
+static u8t batch_handle(int received)
+{
+    transport_peer_t peer;
+    u16t start, len;
+    u8t i, count = 0;
+
+    usm_set_time(uptime());
+    for (i = 0; i < received; i++) {
+        if (requests.msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            /* longer than any request the agent handles */
+            continue;
+        }
+        peer.addr = requests.addrs[i].sin6_addr.s6_addr16[7];
+        peer.port = requests.addrs[i].sin6_port;
+        /* Ethernet and loopback take the responses in a single frame */
+        peer.budget = 0;
+        if (transport_handle(&peer, requests.buffers[i], requests.msgs[i].msg_len,
+                responses.buffers[count], &start, &len, MAX_BUF_SIZE) == -1) {
+            continue;
+        }
+        responses.iovecs[count].iov_base = responses.buffers[count] + start;
+        responses.iovecs[count].iov_len = len;
+        responses.addrs[count] = requests.addrs[i];
+        responses.msgs[count].msg_hdr.msg_namelen = requests.msgs[i].msg_hdr.msg_namelen;
+        count++;
+    }
+    return count;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append the pending trace records to the trace file.
+ */
+static void trace_write()
+{
+    u8t batch[TRACE_HEADER_LEN + TRACE_BUF_SIZE];
+    u16t len;
+    if (!trace_file) {
+        return;
+    }
+    while ((len = trace_drain(batch, sizeof(batch))) != 0) {
+        fwrite(batch, 1, len, trace_file);
+    }
+    fflush(trace_file);
+}
+
+int main(int argc, char** argv)
+{
+    u16t port = DEFAULT_PORT;
+    struct pollfd fds;
+    int received, sent, opt, timeout;
+    u8t count, i;
+
+    while ((opt = getopt(argc, argv, "p:t:i:")) != -1) {
+        if (opt == 'p') {
+            port = atoi(optarg);
+        } else if (opt == 't' && (trace_file = fopen(optarg, "ab")) == NULL) {
+            perror(optarg);
+            return 1;
+        } else if (opt == 'i' && set_manager(optarg) == -1) {
+            fprintf(stderr, "bad manager %s\n", optarg);
+            return 1;
+        } else if (opt != 't' && opt != 'i') {
+            fprintf(stderr, "usage: %s [-p port] [-t trace-file] [-i manager[/port]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc) {
+        fprintf(stderr, "usage: %s [-p port] [-t trace-file] [-i manager[/port]]\n", argv[0]);
+        return 1;
+    }
+    uptime();
+#if ENABLE_AGENT_STATS
+    stats_set_clock(&stats_clock);
+#endif /* ENABLE_AGENT_STATS */
+    if (usm_init() == -1) {
+        fprintf(stderr, "error occurs while initializing the security model\n");
+        return 1;
+    }
+    if (mib_init() == -1) {
+        fprintf(stderr, "error occurs while initializing the MIB\n");
+        return 1;
+    }
+    sock = open_socket(port);
+    if (sock == -1) {
+        return 1;
+    }
+    if (manager.sin6_family) {
+        notification_init(&notification_send, manager.sin6_addr.s6_addr16[7], manager.sin6_port);
+        inform_raise(&cold_start_oid, 0, inform_clock(), INFORM_TIMEOUT_MS);
+    }
+
+    fds.fd = sock;
+    fds.events = POLLIN;
+    while (1) {
+        /* the Informs are retransmitted while no request comes */
+        timeout = inform_wait();
+        if (timeout != -1 && poll(&fds, 1, timeout) <= 0) {
+            continue;
+        }
+        batch_reset(&requests);
+        /* wait for the first datagram and take the ones already queued with it */
+        received = recvmmsg(sock, requests.msgs, BATCH_LEN, MSG_WAITFORONE, NULL);
+        if (received == -1) {
+            perror("recvmmsg");
+            continue;
+        }
+        batch_reset(&responses);
+        count = batch_handle(received);
+        for (i = 0; i < count; i += sent) {
+            sent = sendmmsg(sock, responses.msgs + i, count - i, 0);
+            if (sent <= 0) {
+                perror("sendmmsg");
+                break;
+            }
+        }
+        trace_write();
+    }
+    return 0;
+}
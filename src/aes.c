@@ -0,0 +1,155 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         AES-128 block cipher (FIPS 197) in the CFB-128 mode
+ *
+ *         The CFB mode uses the forward cipher only, so the inverse cipher is not implemented.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#include "aes.h"
+
+static const u8t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+/* multiplication by x in GF(2^8) */
+#define XTIME(x)    ((u8t)(((x) << 1) ^ (((x) & 0x80) ? 0x1b : 0x00)))
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Expand the key into the round keys.
+ */
+void aes_init(aes_ctx_t* ctx, const u8t* key)
+{
+    u8t* w = ctx->round_keys;
+    u8t i, tmp[4], rcon = 0x01;
+
+    memcpy(w, key, AES_KEY_LEN);
+    for (i = AES_KEY_LEN; i < sizeof(ctx->round_keys); i += 4) {
+        memcpy(tmp, w + i - 4, 4);
+        if (i % AES_KEY_LEN == 0) {
+            /* RotWord, SubWord and the round constant */
+            u8t t = tmp[0];
+            tmp[0] = sbox[tmp[1]] ^ rcon;
+            tmp[1] = sbox[tmp[2]];
+            tmp[2] = sbox[tmp[3]];
+            tmp[3] = sbox[t];
+            rcon = XTIME(rcon);
+        }
+        w[i] = w[i - AES_KEY_LEN] ^ tmp[0];
+        w[i + 1] = w[i + 1 - AES_KEY_LEN] ^ tmp[1];
+        w[i + 2] = w[i + 2 - AES_KEY_LEN] ^ tmp[2];
+        w[i + 3] = w[i + 3 - AES_KEY_LEN] ^ tmp[3];
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encrypt a block in place.
+ */
+static void aes_encrypt_block(const aes_ctx_t* ctx, u8t* s)
+{
+    const u8t* k = ctx->round_keys;
+    u8t round, i, t, a0, a1, a2, a3;
+
+    for (i = 0; i < AES_BLOCK_LEN; i++) {
+        s[i] ^= k[i];
+    }
+    for (round = 1; round <= AES_ROUNDS; round++) {
+        /* SubBytes and ShiftRows, the state is stored column by column */
+        for (i = 0; i < AES_BLOCK_LEN; i++) {
+            s[i] = sbox[s[i]];
+        }
+        t = s[1]; s[1] = s[5]; s[5] = s[9]; s[9] = s[13]; s[13] = t;
+        t = s[2]; s[2] = s[10]; s[10] = t;
+        t = s[6]; s[6] = s[14]; s[14] = t;
+        t = s[3]; s[3] = s[15]; s[15] = s[11]; s[11] = s[7]; s[7] = t;
+
+        /* MixColumns, skipped in the last round */
+        if (round != AES_ROUNDS) {
+            for (i = 0; i < AES_BLOCK_LEN; i += 4) {
+                a0 = s[i];
+                a1 = s[i + 1];
+                a2 = s[i + 2];
+                a3 = s[i + 3];
+                t = a0 ^ a1 ^ a2 ^ a3;
+                s[i] ^= t ^ XTIME(a0 ^ a1);
+                s[i + 1] ^= t ^ XTIME(a1 ^ a2);
+                s[i + 2] ^= t ^ XTIME(a2 ^ a3);
+                s[i + 3] ^= t ^ XTIME(a3 ^ a0);
+            }
+        }
+
+        /* AddRoundKey */
+        k += AES_BLOCK_LEN;
+        for (i = 0; i < AES_BLOCK_LEN; i++) {
+            s[i] ^= k[i];
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encrypt or decrypt the data in place in the CFB-128 mode.
+ */
+void aes_cfb(const aes_ctx_t* ctx, u8t* iv, u8t* data, u16t len, u8t decrypt)
+{
+    u8t keystream[AES_BLOCK_LEN];
+    u8t j;
+    u16t i;
+
+    for (i = 0; i < len; i++) {
+        j = i & (AES_BLOCK_LEN - 1);
+        if (j == 0) {
+            memcpy(keystream, iv, AES_BLOCK_LEN);
+            aes_encrypt_block(ctx, keystream);
+        }
+        /* the ciphertext is fed back */
+        if (decrypt) {
+            iv[j] = data[i];
+            data[i] ^= keystream[j];
+        } else {
+            data[i] ^= keystream[j];
+            iv[j] = data[i];
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         AES-128 block cipher (FIPS 197) in the CFB-128 mode
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __AES_H__
+#define	__AES_H__
+
+#include "snmpd-types.h"
+
+#define AES_KEY_LEN         16
+#define AES_BLOCK_LEN       16
+#define AES_ROUNDS          10
+
+/** \brief Expanded key, computed once per key. */
+typedef struct {
+    u8t     round_keys[(AES_ROUNDS + 1) * AES_BLOCK_LEN];
+} aes_ctx_t;
+
+void aes_init(aes_ctx_t* ctx, const u8t* key);
+
+/*
+ * Encrypts or decrypts the data in place in the CFB-128 mode.
+ * The initialization vector is used as the feedback register and is overwritten.
+ */
+void aes_cfb(const aes_ctx_t* ctx, u8t* iv, u8t* data, u16t len, u8t decrypt);
+
+#endif	/* __AES_H__ */
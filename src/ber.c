@@ -25,12 +25,12 @@
 #include "logging.h"
 #include "utils.h"
 
+#define TRACE_FILE 1
 
-#define DECN(pos, value) (*pos) -= value; if (*pos < 0) { snmp_log("too big message: %d\n", __LINE__); return -1;}
 
-#define DEC(pos) DECN(pos, 1)
+#define CHECK_SPACE(pos, len, max_len) if (*(pos) + (len) > (max_len)) { snmp_log("too big message: %d\n", __LINE__); return -1;}
 
-#define TRY(c) if (c < 0) { snmp_log("exception line: %d\n", __LINE__); return c; }
+#define TRY(c) { s8t try_ret = (c); if (try_ret < 0) { snmp_log("exception line: %d\n", __LINE__); return try_ret; } }
 
 #define CHECK_PTR_MA(ptr) if (!ptr) { snmp_log("can not allocate memory, line: %d\n", __LINE__); return ERR_MEMORY_ALLOCATION; }
 
@@ -133,7 +133,7 @@ s8t ber_decode_length(const u8t* const input, const u16t len, u16t* pos, u16t* l
  */
 s8t ber_decode_type_length(const u8t* const input, const u16t len, u16t* pos, u8t* type, u16t* length)
 {
-    if (ber_decode_type(input, len, pos, type) == -1 || !ber_decode_length(input, len, pos, length) == -1) {
+    if (ber_decode_type(input, len, pos, type) == -1 || ber_decode_length(input, len, pos, length) == -1) {
         return -1;
     }
     return 0;
@@ -194,8 +194,8 @@ s8t ber_decode_unsigned_integer(const u8t* const input, const u16t len, u16t* po
     u16t length;
     /* type and length */
     TRY(ber_decode_type_length(input, len, pos, &type, &length));
-    if (type != BER_TYPE_GAUGE || length < 1) {
-        snmp_log("bad type or length value for an expected integer: type %02X length %d\n", type, length);
+    if ((type != BER_TYPE_COUNTER && type != BER_TYPE_GAUGE && type != BER_TYPE_TIME_TICKS) || length < 1) {
+        snmp_log("bad type or length value for an expected unsigned integer: type %02X length %d\n", type, length);
         return -1;
     }
 
@@ -216,7 +216,37 @@ s8t ber_decode_unsigned_integer(const u8t* const input, const u16t len, u16t* po
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Decode a BER encoded unsigned integer value.
+ * Decode a BER encoded Counter64 value, which takes up to 9 bytes with the leading zero.
+ */
+static s8t ber_decode_unsigned64(const u8t* const input, const u16t len, u16t* pos, u64t* value)
+{
+    u8t type;
+    u16t length;
+    TRY(ber_decode_type_length(input, len, pos, &type, &length));
+    if (type != BER_TYPE_COUNTER64 || length < 1 || length > 9) {
+        snmp_log("bad type or length value for an expected Counter64: type %02X length %d\n", type, length);
+        return -1;
+    }
+    if (*pos + length > len) {
+        snmp_log("can't fetch a Counter64: unexpected end of the SNMP request\n");
+        return -1;
+    }
+    if (length == 9 && input[*pos]) {
+        snmp_log("too big Counter64\n");
+        return -1;
+    }
+    *value = 0;
+    while (length--) {
+        *value = (*value << 8) | input[*pos];
+        *pos = *pos + 1;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a BER encoded octet string.
+ * The value is not copied but points into the input, so it is valid only while the input is.
  */
 s8t ber_decode_string(const u8t* const input, const u16t len, u16t* pos, u8t** value, u16t* field_len)
 {
@@ -227,10 +257,7 @@ s8t ber_decode_string(const u8t* const input, const u16t len, u16t* pos, u8t** v
         return -1;
     }
     if (*pos + *field_len - 1 < len) {
-        *value = (u8t*)malloc(*field_len + 1);
-        CHECK_PTR_MA(*value);
-        memcpy(*value, &input[*pos], *field_len);
-        (*value)[*field_len] = 0;
+        *value = (u8t*)&input[*pos];
         *pos = *pos + *field_len;
     } else {
         snmp_log("can't fetch an octet string: unexpected end of the SNMP input\n");
@@ -253,16 +280,15 @@ s8t ber_decode_oid(const u8t* const input, const u16t len, u16t* pos, oid_t* o)
         return -1;
     }
 
-    if (*pos - 1 < len) {
-        oid_item_t *cur_ptr, *prev_ptr;
+    if (*pos + length - 1 < len) {
+        OID_T* cur_ptr;
         /* The first element after the length contains two OID values.
          * The first value can be obtained by dividing this element by 40.
          * The second data element can be obtained by taking the remainder from the previous division.
          */
         if (!(input[*pos] & 0x80)) {
-            o->first_ptr = oid_item_list_append(0, input[*pos] / 40);
-            CHECK_PTR_MA(o->first_ptr);
-            prev_ptr = oid_item_list_append(o->first_ptr, input[*pos] % 40);
+            o->values[0] = input[*pos] / 40;
+            o->values[1] = input[*pos] % 40;
             o->len = 2;
             *pos = *pos + 1;
             (length)--;
@@ -272,13 +298,18 @@ s8t ber_decode_oid(const u8t* const input, const u16t len, u16t* pos, oid_t* o)
         }
 
         while (length) {
-            cur_ptr = oid_item_list_append(prev_ptr, 0);
+            if (o->len == OID_LEN) {
+                snmp_log("oid is longer than %d elements\n", OID_LEN);
+                return -1;
+            }
+            cur_ptr = &o->values[o->len];
+            *cur_ptr = 0;
             o->len++;
             while ((length)--) {
                 /* Check bit 8 to see of there are more octets that make up this element of the OID.
                  * If bit 8 is set, then multiply the octet by 128 and then add the lower bits to the result.
                  */
-                cur_ptr->value = (cur_ptr->value << 7) + (input[*pos] & 0x7F);
+                *cur_ptr = (*cur_ptr << 7) + (input[*pos] & 0x7F);
                 if (input[*pos] & 0x80) {
                     if ((length) == 0) {
                         snmp_log("can't fetch an oid: unexpected end of the SNMP input\n");
@@ -290,7 +321,6 @@ s8t ber_decode_oid(const u8t* const input, const u16t len, u16t* pos, oid_t* o)
                     break;
                 }
             }
-            prev_ptr = cur_ptr;
         }
     } else {
         snmp_log("can't fetch an oid: unexpected end of the SNMP request\n");
@@ -326,6 +356,9 @@ s8t ber_decode_void(const u8t* const input, const u16t len, u16t* pos)
  * Decode a BER encoded value.
  */
 s8t ber_decode_value(const u8t* const input, const u16t len, u16t* pos, u8t* value_type, varbind_value_t* value) {
+    oid_t* oid_ptr;
+    u8t type;
+    u16t length;
     if (*pos < len) {
         *value_type = input[*pos];
         switch (input[*pos]) {
@@ -344,8 +377,28 @@ s8t ber_decode_value(const u8t* const input, const u16t len, u16t* pos, u8t* val
             case BER_TYPE_COUNTER:
                 TRY(ber_decode_unsigned_integer(input, len, pos, &value->u_value));
                 break;
-            case BER_TYPE_OPAQUE:
+            case BER_TYPE_COUNTER64:
+                value->u64_value = arena_alloc(sizeof(u64t));
+                CHECK_PTR_MA(value->u64_value);
+                TRY(ber_decode_unsigned64(input, len, pos, value->u64_value));
+                break;
             case BER_TYPE_OID:
+                oid_ptr = oid_create();
+                CHECK_PTR_MA(oid_ptr);
+                TRY(ber_decode_oid(input, len, pos, oid_ptr));
+                value->oid_value = oid_ptr;
+                break;
+            case BER_TYPE_NO_SUCH_OBJECT:
+            case BER_TYPE_NO_SUCH_INSTANCE:
+            case BER_TYPE_END_OF_MIB_VIEW:
+                /* the exceptions come only in responses, which are decoded by the proxies of the host build */
+                TRY(ber_decode_type_length(input, len, pos, &type, &length));
+                if (length != 0) {
+                    snmp_log("bad length of an exception: %d\n", length);
+                    return -1;
+                }
+                break;
+            case BER_TYPE_OPAQUE:
                 return -1;
             default:
                 snmp_log("unsupported BER type %02X\n", input[*pos]);
@@ -360,9 +413,10 @@ s8t ber_decode_value(const u8t* const input, const u16t len, u16t* pos, u8t* val
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Parse a BER encoded SNMP request.
+ * Parse the header of a BER encoded PDU up to its variable bindings.
  */
-s8t ber_decode_pdu(const u8t* const input, const u16t len, u16t* pos, pdu_t* pdu) {
+static s8t ber_decode_pdu_header(const u8t* const input, const u16t len, u16t* pos, pdu_t* pdu)
+{
     /* request PDU */
     u16t length;
     s32t tmp;
@@ -379,66 +433,220 @@ s8t ber_decode_pdu(const u8t* const input, const u16t len, u16t* pos, pdu_t* pdu
     TRY(ber_decode_integer(input, len, pos, &pdu->request_id));
     snmp_log("request id: %d\n", pdu->request_id);
 
-    /* error-state */
-    TRY(ber_decode_integer(input, len, pos, &tmp));
-    pdu->error_status = (u8t)tmp;
-    snmp_log("error-status: %d\n", pdu->error_status);
+    if (pdu->request_type == BER_TYPE_SNMP_GETBULK) {
+        /* non-repeaters */
+        TRY(ber_decode_integer(input, len, pos, &tmp));
+        pdu->non_repeaters = (u16t)(tmp < 0 ? 0 : min(tmp, 0xFFFF));
+        snmp_log("non-repeaters: %d\n", pdu->non_repeaters);
 
-    /* error-index */
-    TRY(ber_decode_integer(input, len, pos, &tmp));
-    pdu->error_index = (u8t)tmp;
-    snmp_log("error-index: %d\n", pdu->error_index);
+        /* max-repetitions */
+        TRY(ber_decode_integer(input, len, pos, &tmp));
+        pdu->max_repetitions = (u16t)(tmp < 0 ? 0 : min(tmp, 0xFFFF));
+        snmp_log("max-repetitions: %d\n", pdu->max_repetitions);
+    } else {
+        /* error-state */
+        TRY(ber_decode_integer(input, len, pos, &tmp));
+        pdu->error_status = (u8t)tmp;
+        snmp_log("error-status: %d\n", pdu->error_status);
+
+        /* error-index */
+        TRY(ber_decode_integer(input, len, pos, &tmp));
+        pdu->error_index = (u8t)tmp;
+        snmp_log("error-index: %d\n", pdu->error_index);
+    }
 
     /* variable-bindings */
     pdu->varbind_index = *pos;
     snmp_log("varbind index %d\n", *pos);
     TRY(ber_decode_sequence(input, len, pos, 1));
 
-    /* variable binding list */
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a variable binding into the OID the variable binding points to.
+ * Only OID and Counter64 values are allocated in the request arena.
+ */
+s8t ber_decode_var_bind(const u8t* const input, const u16t len, u16t* pos, varbind_t* varbind)
+{
+    /* sequence */
+    TRY(ber_decode_sequence(input, len, pos, 0));
+
+    /* OID */
+    TRY(ber_decode_oid(input, len, pos, varbind->oid_ptr));
+
+    /* void value */
+    TRY(ber_decode_value(input, len, pos, &varbind->value_type, &varbind->value));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode the variable bindings from the position up to the end of the message into a list.
+ */
+s8t ber_decode_var_binds(const u8t* const input, const u16t len, u16t* pos, message_t* request)
+{
+    pdu_t* pdu = &request->pdu;
+    varbind_t* cur_ptr = 0;
     pdu->varbind_len = 0;
     pdu->varbind_first_ptr = 0;
-    varbind_t* cur_ptr = 0;
     while (*pos < len) {
-        /* sequence */
-        TRY(ber_decode_sequence(input, len, pos, 0));
-
-        if (!pdu->varbind_first_ptr) {
-            cur_ptr = pdu->varbind_first_ptr = varbind_list_append(0);
-        } else {
-            cur_ptr = varbind_list_append(cur_ptr);
-        }
+        cur_ptr = varbind_list_append(cur_ptr);
         if (!cur_ptr) {
             return ERR_MEMORY_ALLOCATION;
         }
-        
-        /* OID */
+        if (!pdu->varbind_first_ptr) {
+            pdu->varbind_first_ptr = cur_ptr;
+        }
         cur_ptr->oid_ptr = oid_create();
-        TRY(ber_decode_oid(input, len, pos, cur_ptr->oid_ptr));
-
-        /* void value */
-        TRY(ber_decode_value(input, len, pos, &cur_ptr->value_type, &cur_ptr->value));
+        CHECK_PTR_MA(cur_ptr->oid_ptr);
+        TRY(ber_decode_var_bind(input, len, pos, cur_ptr));
         pdu->varbind_len++;
     }
     return 0;
 }
 
+#if ENABLE_SNMPv3
 /*-----------------------------------------------------------------------------------*/
 /*
- * Parse a BER encoded SNMP request.
+ * Decode a BER encoded octet string of an SNMPv3 header which is at most max_len bytes long.
  */
-s8t ber_decode_request(const u8t* const input, const u16t len, message_t* request)
+static s8t ber_decode_short_string(const u8t* const input, const u16t len, u16t* pos, u8t** value, u8t* value_len, const u8t max_len)
+{
+    u16t field_len;
+    TRY(ber_decode_string(input, len, pos, value, &field_len));
+    if (field_len > max_len) {
+        snmp_log("too long string in the SNMPv3 header: %d\n", field_len);
+        return -1;
+    }
+    *value_len = field_len;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode the header and the USM security parameters of an SNMPv3 message.
+ * The position of the authentication parameters is kept, so the digest can be checked in the input.
+ */
+static s8t ber_decode_v3_header(const u8t* const input, const u16t len, u16t* pos, message_v3_t* v3)
 {
-    u16t pos, length;
+    u8t type;
+    u16t length, end;
     s32t tmp;
+    u8t *flags, *auth;
+    u8t flags_len, auth_len;
+
+    /* msgGlobalData */
+    TRY(ber_decode_sequence(input, len, pos, 0));
+    TRY(ber_decode_integer(input, len, pos, &v3->msg_id));
+    TRY(ber_decode_integer(input, len, pos, &v3->msg_max_size));
+    TRY(ber_decode_short_string(input, len, pos, &flags, &flags_len, 1));
+    TRY(ber_decode_integer(input, len, pos, &tmp));
+    if (flags_len != 1 || tmp != SNMP_SECURITY_MODEL_USM || v3->msg_max_size < 484) {
+        snmp_log("unsupported SNMPv3 header: security model %d max size %d\n", tmp, v3->msg_max_size);
+        return -1;
+    }
+    v3->msg_flags = flags[0];
+    if ((v3->msg_flags & SNMP_MSG_FLAG_PRIV) && !(v3->msg_flags & SNMP_MSG_FLAG_AUTH)) {
+        snmp_log("privacy without authentication requested\n");
+        return -1;
+    }
 
-    pos = 0;
+    /* msgSecurityParameters, the USM parameters wrapped into an octet string */
+    TRY(ber_decode_type_length(input, len, pos, &type, &length));
+    if (type != BER_TYPE_OCTET_STRING || length > len - *pos) {
+        snmp_log("bad security parameters: type %02X length %d\n", type, length);
+        return -1;
+    }
+    end = *pos + length;
+    TRY(ber_decode_sequence(input, end, pos, 1));
+    TRY(ber_decode_short_string(input, end, pos, &v3->engine_id, &v3->engine_id_len, 32));
+    TRY(ber_decode_integer(input, end, pos, &v3->engine_boots));
+    TRY(ber_decode_integer(input, end, pos, &v3->engine_time));
+    TRY(ber_decode_short_string(input, end, pos, &v3->user, &v3->user_len, 32));
+    TRY(ber_decode_short_string(input, end, pos, &auth, &auth_len, SNMP_AUTH_PARAMS_LEN));
+    v3->auth_params_pos = (auth_len == SNMP_AUTH_PARAMS_LEN) ? auth - input : 0;
+    TRY(ber_decode_short_string(input, end, pos, &v3->priv_params, &v3->priv_params_len, 32));
+    if (*pos != end) {
+        snmp_log("unexpected data after the security parameters\n");
+        return -1;
+    }
+    snmp_log("user length: %d flags: %02X\n", v3->user_len, v3->msg_flags);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse the header of the plaintext scoped PDU of an SNMPv3 message up to its variable bindings.
+ */
+static s8t ber_decode_scoped_pdu_header(const u8t* const input, const u16t len, u16t* pos, message_t* request)
+{
+    message_v3_t* v3 = &request->v3;
+    *pos = v3->scoped_pdu_pos;
+    TRY(ber_decode_sequence(input, len, pos, 1));
+    TRY(ber_decode_short_string(input, len, pos, &v3->context_engine_id, &v3->context_engine_id_len, 32));
+    TRY(ber_decode_short_string(input, len, pos, &v3->context_name, &v3->context_name_len, 32));
+
+    /* PDU encoding */
+    return ber_decode_pdu_header(input, len, pos, &request->pdu);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse the plaintext scoped PDU of an SNMPv3 message.
+ */
+s8t ber_decode_scoped_pdu(const u8t* const input, const u16t len, message_t* request)
+{
+    u16t pos;
+    TRY(ber_decode_scoped_pdu_header(input, len, &pos, request));
+    TRY(ber_decode_var_binds(input, len, &pos, request));
+
+    snmp_log("parsing finished: OK\n");
+    return 0;
+}
+#endif /* ENABLE_SNMPv3 */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse the header of a BER encoded SNMP request up to its variable bindings.
+ * The position of the first variable binding is stored in pos, it is the end of the message
+ * if the scoped PDU is encrypted, since the security model decodes the whole scoped PDU then.
+ */
+s8t ber_decode_header(const u8t* const input, const u16t len, u16t* pos, message_t* request)
+{
+    s32t tmp;
+#if ENABLE_SNMPv3
+    u8t type;
+    u16t length;
+#endif /* ENABLE_SNMPv3 */
+
+    *pos = 0;
 
     /* Sequence */
-    TRY(ber_decode_sequence(input, len, &pos, 1));
+    TRY(ber_decode_sequence(input, len, pos, 1));
 
     /* version */
-    TRY(ber_decode_integer(input, len, &pos, &tmp));
+    TRY(ber_decode_integer(input, len, pos, &tmp));
     request->version = (u8t)tmp;
+#if ENABLE_SNMPv3
+    if (request->version == SNMP_VERSION_3) {
+        TRY(ber_decode_v3_header(input, len, pos, &request->v3));
+        if (request->v3.msg_flags & SNMP_MSG_FLAG_PRIV) {
+            /* the security model decrypts the scoped PDU in place and decodes it */
+            TRY(ber_decode_type_length(input, len, pos, &type, &length));
+            if (type != BER_TYPE_OCTET_STRING || length != len - *pos) {
+                snmp_log("bad encrypted scoped PDU: type %02X length %d\n", type, length);
+                return -1;
+            }
+            request->v3.scoped_pdu_pos = *pos;
+            *pos = len;
+            return 0;
+        }
+        request->v3.scoped_pdu_pos = *pos;
+        return ber_decode_scoped_pdu_header(input, len, pos, request);
+    }
+#endif /* ENABLE_SNMPv3 */
     if (request->version != SNMP_VERSION_1 && request->version != SNMP_VERSION_2C) {
         /* it then verifies the version number of the SNMP message.  */
         /* if there is no mismatch, it discards the datagram and performs no further actions. */
@@ -448,17 +656,27 @@ s8t ber_decode_request(const u8t* const input, const u16t len, message_t* reques
     snmp_log("snmp version: %d\n", request->version);
 
     /* community name */
-    if (ber_decode_string((u8t*)input, len, &pos, &request->community, &length) == -1) {
+    if (ber_decode_string(input, len, pos, &request->community, &request->community_len) == -1) {
         return -1;
-    } else if (strlen((char*)request->community) < 1) {
-        snmp_log("unsupported SNMP community '%s'\n", request->community);
+    } else if (request->community_len < 1) {
+        snmp_log("unsupported SNMP community of length %d\n", request->community_len);
         return -1;
     }
-    snmp_log("community string: %s\n", request->community);
+    snmp_log("community string length: %d\n", request->community_len);
 
     /* PDU encoding */
-    s8t ret = ber_decode_pdu(input, len, &pos, &request->pdu);
-    TRY(ret);
+    return ber_decode_pdu_header(input, len, pos, &request->pdu);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse a BER encoded SNMP request.
+ */
+s8t ber_decode_request(const u8t* const input, const u16t len, message_t* request)
+{
+    u16t pos;
+    TRY(ber_decode_header(input, len, &pos, request));
+    TRY(ber_decode_var_binds(input, len, &pos, request));
 
     snmp_log("parsing finished: OK\n");
 
@@ -466,39 +684,230 @@ s8t ber_decode_request(const u8t* const input, const u16t len, message_t* reques
 }
 
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of bytes of a BER encoded length field.
+ */
+static u8t ber_length_size(u16t length)
+{
+    if (length > 0xFF) {
+        return 3;
+    } else if (length > 0x7F) {
+        return 2;
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of bytes of a BER encoded sub-identifier of an OID.
+ */
+static u8t ber_oid_element_size(const OID_T value)
+{
+    if (value >= (268435456)) { // 2 ^ 28
+        return 5;
+    } else if (value >= (2097152)) { // 2 ^ 21
+        return 4;
+    } else if (value >= 16384) { // 2 ^ 14
+        return 3;
+    } else if (value >= 128) { // 2 ^ 7
+        return 2;
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a BER encoded OID.
+ */
+static u16t ber_oid_size(const oid_t* const oid)
+{
+    u8t i;
+    /* the first 2 oid elements are encoded in a single byte */
+    u16t length = 1;
+    for (i = 2; i < oid->len; i++) {
+        length += ber_oid_element_size(oid->values[i]);
+    }
+    return length;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a BER encoded integer.
+ */
+static u8t ber_integer_size(const s32t value)
+{
+    if (value < -16777216 || value > 16777215) {
+        return 4;
+    } else if (value < -32768 || value > 32767) {
+        return 3;
+    } else if (value < -128 || value > 127) {
+        return 2;
+    }
+    return 1;
+}
+
+#if ENABLE_SNMPv3
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of bytes of a BER encoded octet string.
+ */
+static u16t ber_string_size(const u16t len)
+{
+    return 1 + ber_length_size(len) + len;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the number of bytes of the version, the global data and the security parameters
+ * of an SNMPv3 message. The lengths of the global data and of the USM parameters
+ * sequences are returned separately.
+ */
+static u16t ber_v3_header_size(const message_v3_t* const v3, u16t* global_len, u16t* usm_len)
+{
+    *global_len = 2 + ber_integer_size(v3->msg_id) + 2 + ber_integer_size(v3->msg_max_size) + 3 + 3;
+    *usm_len = ber_string_size(v3->engine_id_len) +
+            2 + ber_integer_size(v3->engine_boots) + 2 + ber_integer_size(v3->engine_time) +
+            ber_string_size(v3->user_len) +
+            ber_string_size((v3->msg_flags & SNMP_MSG_FLAG_AUTH) ? SNMP_AUTH_PARAMS_LEN : 0) +
+            ber_string_size(v3->priv_params_len);
+    return 3 + 1 + ber_length_size(*global_len) + *global_len +
+            ber_string_size(1 + ber_length_size(*usm_len) + *usm_len);
+}
+#endif /* ENABLE_SNMPv3 */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a BER encoded unsigned integer.
+ */
+static u8t ber_unsigned_integer_size(const u32t value)
+{
+    if (value & 0xFF000000) {
+        return 4;
+    } else if (value & 0x00FF0000) {
+        return 3;
+    } else if (value & 0x0000FF00) {
+        return 2;
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a BER encoded Counter64, a zero byte is prepended
+ * if the most significant bit is set.
+ */
+static u8t ber_unsigned64_size(const u64t value)
+{
+    u8t length = 1;
+    while (length < 9 && (value >> (8 * length - 1))) {
+        length++;
+    }
+    return length;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a variable binding.
+ */
+static u16t ber_value_size(const varbind_t* const varbind)
+{
+    switch (varbind->value_type) {
+        case BER_TYPE_OCTET_STRING:
+            return varbind->value.s_value.len;
+        case BER_TYPE_INTEGER:
+            return ber_integer_size(varbind->value.i_value);
+        case BER_TYPE_COUNTER:
+        case BER_TYPE_GAUGE:
+        case BER_TYPE_TIME_TICKS:
+            return ber_unsigned_integer_size(varbind->value.u_value);
+        case BER_TYPE_COUNTER64:
+            return ber_unsigned64_size(VARBIND_U64(varbind->value));
+        case BER_TYPE_OID:
+            return ber_oid_size(varbind->value.oid_value);
+        default:
+            return 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of a BER encoded variable binding sequence.
+ */
+static u16t ber_var_bind_content_size(const varbind_t* const varbind)
+{
+    u16t length, oid_length = ber_oid_size(varbind->oid_ptr);
+    length = 1 + ber_length_size(oid_length) + oid_length;
+    switch (varbind->value_type) {
+        case BER_TYPE_OCTET_STRING:
+        case BER_TYPE_INTEGER:
+        case BER_TYPE_COUNTER:
+        case BER_TYPE_GAUGE:
+        case BER_TYPE_TIME_TICKS:
+        case BER_TYPE_COUNTER64:
+        case BER_TYPE_OID:
+        case BER_TYPE_NO_SUCH_OBJECT:
+        case BER_TYPE_NO_SUCH_INSTANCE:
+        case BER_TYPE_END_OF_MIB_VIEW:
+            length += 1 + ber_length_size(ber_value_size(varbind)) + ber_value_size(varbind);
+            break;
+        case BER_TYPE_NULL:
+            length += ber_void_null.len;
+            break;
+        default:
+            break;
+    }
+    return length;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of a BER encoded variable binding including its sequence header.
+ */
+u16t ber_var_bind_size(const varbind_t* const varbind)
+{
+    if (varbind->encoded_ptr) {
+        return varbind->encoded_len;
+    }
+    u16t length = ber_var_bind_content_size(varbind);
+    return 1 + ber_length_size(length) + length;
+}
+
 /*-----------------------------------------------------------------------------------*/
 /*
  * Write a BER encoded length to the buffer
  */
-s8t ber_encode_length(u8t* output, s16t* pos, u16t length)
+s8t ber_encode_length(u8t* output, u16t* pos, const u16t max_len, u16t length)
 {
+    CHECK_SPACE(pos, ber_length_size(length), max_len);
     if (length > 0xFF) {
-        DECN(pos, 3);
         /* first "the length of the length" goes in octets */
         /* the bit 0x80 of the first byte is set to show that the length is composed of multiple octets */
         output[*pos] = 0x82;
         output[*pos + 1] = (length >> 8) & 0xFF;
         output[*pos + 2] = length & 0xFF;
+        *pos = *pos + 3;
     } else if (length > 0x7F) {
-        DECN(pos, 2);
         output[*pos] = 0x81;
-	output[*pos + 1] = length & 0xFF;
+        output[*pos + 1] = length & 0xFF;
+        *pos = *pos + 2;
     } else {
-        DEC(pos);
         output[*pos] = length & 0x7F;
+        *pos = *pos + 1;
     }
     return 0;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Write a BER encoded variable binding to the buffer
+ * Write BER encoded type and length fields to the buffer
  */
-s8t ber_encode_type_length(u8t* output, s16t* pos, u8t type, u16t len)
+s8t ber_encode_type_length(u8t* output, u16t* pos, const u16t max_len, u8t type, u16t len)
 {
-    TRY(ber_encode_length(output, pos, len));
-    DEC(pos);
+    CHECK_SPACE(pos, 1, max_len);
     output[*pos] = type;
+    *pos = *pos + 1;
+    TRY(ber_encode_length(output, pos, max_len, len));
     return 0;
 }
 
@@ -506,82 +915,49 @@ s8t ber_encode_type_length(u8t* output, s16t* pos, u8t type, u16t len)
 /*
  * Write a BER encoded oid to the buffer
  */
-s8t ber_encode_oid(u8t* output, s16t* pos, oid_t* const  oid)
+s8t ber_encode_oid(u8t* output, u16t* pos, const u16t max_len, const oid_t* const oid)
 {
-    u8t length;
-    u8t i;
+    u8t i, length;
     s8t j;
-    u16t oid_length;
-    /* reverse order, since we encode from the end */
-    oid->first_ptr = oid_item_list_reverse(oid->first_ptr);
-    oid_length = 1;
-    oid_item_t *cur_ptr = oid->first_ptr;
-    /* encode oids from the last to the 2nd */
-    for (i = oid->len; i > 2; i--) {
-        if (cur_ptr->value >= (268435456)) { // 2 ^ 28
-            length = 5;
-        } else if (cur_ptr->value >= (2097152)) { // 2 ^ 21
-            length = 4;
-        } else if (cur_ptr->value >= 16384) { // 2 ^ 14
-            length = 3;
-        } else if (cur_ptr->value >= 128) { // 2 ^ 7
-            length = 2;
-        } else {
-            length = 1;
-        }
-        oid_length += length;
-        DECN(pos,  length);
-        for (j = length - 1; j >= 0; j--) {
-            if (j) {
-                output[*pos + length - j - 1] = ((cur_ptr->value >> (7 * j)) & 0x7F) | 0x80;
-            } else {
-                output[*pos + length - j - 1] = ((cur_ptr->value >> (7 * j)) & 0x7F);
-            }
-        }
-        cur_ptr = cur_ptr->next_ptr;
-    }
-    /* the value of the first 2 oid elements are enconded in the first byte as = 40 * 1st + 2nd */
-    DEC(pos);
-    output[*pos] = cur_ptr->next_ptr->value * 40 + cur_ptr->value;
+    u16t oid_length = ber_oid_size(oid);
 
     /* type and length */
-    TRY(ber_encode_type_length(output, pos, BER_TYPE_OID, oid_length));
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_OID, oid_length));
+    CHECK_SPACE(pos, oid_length, max_len);
 
+    /* the value of the first 2 oid elements are enconded in the first byte as = 40 * 1st + 2nd */
+    output[*pos] = oid->values[0] * 40 + oid->values[1];
+    *pos = *pos + 1;
+
+    /* the rest of the elements use 7 bits of each byte, the bit 8 is set in all bytes but the last one */
+    for (i = 2; i < oid->len; i++) {
+        length = ber_oid_element_size(oid->values[i]);
+        for (j = length - 1; j >= 0; j--) {
+            output[*pos] = ((oid->values[i] >> (7 * j)) & 0x7F) | (j ? 0x80 : 0x00);
+            *pos = *pos + 1;
+        }
+    }
     return 0;
 }
 
-
 /*-----------------------------------------------------------------------------------*/
 /*
  * Write a BER encoded integer to the buffer
  */
-s8t ber_encode_integer(u8t* output, s16t* pos, const s32t value)
+s8t ber_encode_integer(u8t* output, u16t* pos, const u16t max_len, const s32t value)
 {
-    s16t init_pos = *pos;
-    u16t length;
+    u8t length = ber_integer_size(value);
     s8t j;
 
-    /* get the length of the BER encoded integer value in bytes */
-    if (value < -16777216 || value > 16777215) {
-        length = 4;
-    } else if (value < -32768 || value > 32767) {
-        length = 3;
-    } else if (value < -128 || value > 127) {
-        length = 2;
-    } else {
-        length = 1;
-    }
+    /* write type and length */
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_INTEGER, length));
 
     /* write integer value */
-    DECN(pos, length);
+    CHECK_SPACE(pos, length, max_len);
     for (j = length - 1; j >= 0; j--) {
-        output[*pos + (length - 1) - j] = (((u32t)value) >> (8 * j)) & 0xFF;
+        output[*pos] = (((u32t)value) >> (8 * j)) & 0xFF;
+        *pos = *pos + 1;
     }
-
-    /* write type and length */
-    length = init_pos - *pos;
-    TRY(ber_encode_type_length(output, pos, BER_TYPE_INTEGER, length));
-
     return 0;
 }
 
@@ -589,33 +965,41 @@ s8t ber_encode_integer(u8t* output, s16t* pos, const s32t value)
 /*
  * Write a BER encoded unsigned integer to the buffer
  */
-s8t ber_encode_unsigned_integer(u8t* output, s16t* pos, const u8t type, const u32t value)
+s8t ber_encode_unsigned_integer(u8t* output, u16t* pos, const u16t max_len, const u8t type, const u32t value)
 {
-    s16t init_pos = *pos;
-    u16t length;
+    u8t length = ber_unsigned_integer_size(value);
     s8t j;
 
-    /* get the length of the BER encoded integer value in bytes */
-    if (value & 0xFF000000) {
-        length = 4;
-    } else if (value & 0x00FF0000) {
-        length = 3;
-    } else if (value & 0x0000FF00) {
-        length = 2;
-    } else {
-        length = 1;
-    }
+    /* write type and length */
+    TRY(ber_encode_type_length(output, pos, max_len, type, length));
 
     /* write integer value */
-    DECN(pos, length);
+    CHECK_SPACE(pos, length, max_len);
     for (j = length - 1; j >= 0; j--) {
-        output[*pos + (length - 1) - j] = (value >> (8 * j)) & 0xFF;
+        output[*pos] = (value >> (8 * j)) & 0xFF;
+        *pos = *pos + 1;
     }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a BER encoded Counter64 to the buffer
+ */
+static s8t ber_encode_unsigned64(u8t* output, u16t* pos, const u16t max_len, const u64t value)
+{
+    u8t length = ber_unsigned64_size(value);
+    s8t j;
 
     /* write type and length */
-    length = init_pos - *pos;
-    TRY(ber_encode_type_length(output, pos, type, length));
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_COUNTER64, length));
 
+    /* write the value, the shift of the leading zero byte is out of range */
+    CHECK_SPACE(pos, length, max_len);
+    for (j = length - 1; j >= 0; j--) {
+        output[*pos] = j < 8 ? (value >> (8 * j)) & 0xFF : 0;
+        *pos = *pos + 1;
+    }
     return 0;
 }
 
@@ -623,134 +1007,458 @@ s8t ber_encode_unsigned_integer(u8t* output, s16t* pos, const u8t type, const u3
 /*
  * Write a BER encoded string value to the buffer
  */
-s8t ber_encode_fixed_string(u8t* output, s16t* pos, const u8t* const str_value, const u16t len)
+s8t ber_encode_fixed_string(u8t* output, u16t* pos, const u16t max_len, const u8t* const str_value, const u16t len)
 {
-    /* string value */
-    DECN(pos, len);
-    memcpy(output + *pos, str_value, len);
-
     /* type and length */
-    TRY(ber_encode_type_length(output, pos, BER_TYPE_OCTET_STRING, len));
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_OCTET_STRING, len));
 
+    /* string value, an empty one may have no buffer */
+    CHECK_SPACE(pos, len, max_len);
+    if (len) {
+        memcpy(output + *pos, str_value, len);
+    }
+    *pos = *pos + len;
     return 0;
 }
 
-
+#if ENABLE_SNMPv3
 /*-----------------------------------------------------------------------------------*/
 /*
- * Write a BER encoded string value to the buffer
+ * Write the version, the global data and the security parameters of an SNMPv3 message.
+ * The authentication parameters are zeroed and their position is stored in the message,
+ * the security model writes the digest there once the whole message is encoded.
  */
-s8t ber_encode_string(u8t* output, s16t* pos, const u8t* const str_value)
+static s8t ber_encode_v3_header(u8t* output, u16t* pos, const u16t max_len, message_v3_t* v3)
 {
-    return ber_encode_fixed_string(output, pos, str_value, strlen((char*)str_value));
+    u16t global_len, usm_len;
+    ber_v3_header_size(v3, &global_len, &usm_len);
+
+    /* version */
+    TRY(ber_encode_integer(output, pos, max_len, SNMP_VERSION_3));
+
+    /* msgGlobalData */
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_SEQUENCE, global_len));
+    TRY(ber_encode_integer(output, pos, max_len, v3->msg_id));
+    TRY(ber_encode_integer(output, pos, max_len, v3->msg_max_size));
+    TRY(ber_encode_fixed_string(output, pos, max_len, &v3->msg_flags, 1));
+    TRY(ber_encode_integer(output, pos, max_len, SNMP_SECURITY_MODEL_USM));
+
+    /* msgSecurityParameters */
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_OCTET_STRING, 1 + ber_length_size(usm_len) + usm_len));
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_SEQUENCE, usm_len));
+    TRY(ber_encode_fixed_string(output, pos, max_len, v3->engine_id, v3->engine_id_len));
+    TRY(ber_encode_integer(output, pos, max_len, v3->engine_boots));
+    TRY(ber_encode_integer(output, pos, max_len, v3->engine_time));
+    TRY(ber_encode_fixed_string(output, pos, max_len, v3->user, v3->user_len));
+    if (v3->msg_flags & SNMP_MSG_FLAG_AUTH) {
+        TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_OCTET_STRING, SNMP_AUTH_PARAMS_LEN));
+        CHECK_SPACE(pos, SNMP_AUTH_PARAMS_LEN, max_len);
+        v3->auth_params_pos = *pos;
+        memset(output + *pos, 0, SNMP_AUTH_PARAMS_LEN);
+        *pos = *pos + SNMP_AUTH_PARAMS_LEN;
+    } else {
+        TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_OCTET_STRING, 0));
+        v3->auth_params_pos = 0;
+    }
+    TRY(ber_encode_fixed_string(output, pos, max_len, v3->priv_params, v3->priv_params_len));
+    return 0;
 }
+#endif /* ENABLE_SNMPv3 */
 
 /*-----------------------------------------------------------------------------------*/
 /*
  * Write a BER encoded variable binding to the buffer
  */
-s8t ber_encode_var_bind(u8t* output, s16t* pos, const varbind_t* const varbind)
+s8t ber_encode_var_bind(u8t* output, u16t* pos, const u16t max_len, const varbind_t* const varbind)
 {
-    /* write the variable binding in the reverse order */
-    u16t len_pos = *pos;
+    /* the variable binding is already encoded */
+    if (varbind->encoded_ptr) {
+        CHECK_SPACE(pos, varbind->encoded_len, max_len);
+        if (varbind->encoded_pgm) {
+            mib_memcpy_P(output + *pos, varbind->encoded_ptr, varbind->encoded_len);
+        } else {
+            memcpy(output + *pos, varbind->encoded_ptr, varbind->encoded_len);
+        }
+        *pos = *pos + varbind->encoded_len;
+        return 0;
+    }
+
+    u16t len = ber_var_bind_content_size(varbind);
+    /* check the space for the whole variable binding, so nothing is written if it does not fit */
+    CHECK_SPACE(pos, 1 + ber_length_size(len) + len, max_len);
+
+    /* sequence header*/
+    TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_SEQUENCE, len));
+
+    /* oid */
+    TRY(ber_encode_oid(output, pos, max_len, varbind->oid_ptr));
+
     /* value */
     switch (varbind->value_type) {
         case BER_TYPE_OCTET_STRING:
-            TRY(ber_encode_fixed_string(output, pos, varbind->value.s_value.ptr, varbind->value.s_value.len));
+            TRY(ber_encode_fixed_string(output, pos, max_len, varbind->value.s_value.ptr, varbind->value.s_value.len));
             break;
 
         case BER_TYPE_INTEGER:
-            TRY(ber_encode_integer(output, pos, varbind->value.i_value));
+            TRY(ber_encode_integer(output, pos, max_len, varbind->value.i_value));
             break;
 
         case BER_TYPE_NULL:
-            DECN(pos, ber_void_null.len);
-            memcpy(output + (*pos), ber_void_null.buffer, ber_void_null.len);
+            memcpy(output + *pos, ber_void_null.buffer, ber_void_null.len);
+            *pos = *pos + ber_void_null.len;
             break;
         case BER_TYPE_OID:
-            /* TODO: implement */
+            TRY(ber_encode_oid(output, pos, max_len, varbind->value.oid_value));
+            break;
+        case BER_TYPE_NO_SUCH_OBJECT:
+        case BER_TYPE_NO_SUCH_INSTANCE:
+        case BER_TYPE_END_OF_MIB_VIEW:
+            TRY(ber_encode_type_length(output, pos, max_len, varbind->value_type, 0));
             break;
         case BER_TYPE_COUNTER:
         case BER_TYPE_GAUGE:
         case BER_TYPE_TIME_TICKS:
-            TRY(ber_encode_unsigned_integer(output, pos, varbind->value_type, varbind->value.u_value));
+            TRY(ber_encode_unsigned_integer(output, pos, max_len, varbind->value_type, varbind->value.u_value));
+            break;
+        case BER_TYPE_COUNTER64:
+            TRY(ber_encode_unsigned64(output, pos, max_len, VARBIND_U64(varbind->value)));
             break;
         default:
             break;
     }
-    /* oid */
-    TRY(ber_encode_oid(output, pos, varbind->oid_ptr));
-
-    /* sequence header*/
-    len_pos -= *pos;
-    TRY(ber_encode_type_length(output, pos, BER_TYPE_SEQUENCE, len_pos));
     return 0;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Encode SNMP PDU
+ * An error response copies the variable bindings of the request with their sequence header,
+ * unless the request has none to copy, see pdu_t.
+ */
+#define BER_PDU_COPIES_VAR_BINDS(pdu) ((pdu)->error_status != ERROR_STATUS_NO_ERROR && (pdu)->varbind_index)
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of the PDU which variable bindings take the given number of bytes:
+ * without the sequence header of the list if the list is encoded, and as the number of bytes
+ * copied from the request otherwise.
  */
-s8t ber_encode_pdu(u8t* output, s16t* pos, const u8t* const input, u16t input_len, const pdu_t* const  pdu, const u16t max_output_len)
+static u16t ber_pdu_content_size(const pdu_t* const pdu, const u16t varbinds_len)
+{
+    u16t len = 2 + ber_integer_size(pdu->request_id) + 2 + ber_integer_size(pdu->error_status) +
+            2 + ber_integer_size(pdu->error_index);
+    if (!BER_PDU_COPIES_VAR_BINDS(pdu)) {
+        return len + 1 + ber_length_size(varbinds_len) + varbinds_len;
+    }
+    /* the variable bindings of the request are copied with their sequence header */
+    return len + varbinds_len;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of the PDU.
+ * The length of the variable binding list is returned separately as in ber_pdu_content_size.
+ */
+static u16t ber_pdu_size(const u16t input_len, const pdu_t* const pdu, u16t* varbinds_len)
+{
+    varbind_t* ptr;
+    if (!BER_PDU_COPIES_VAR_BINDS(pdu)) {
+        *varbinds_len = 0;
+        for (ptr = pdu->varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+            *varbinds_len += ber_var_bind_size(ptr);
+        }
+    } else {
+        *varbinds_len = input_len - pdu->varbind_index;
+    }
+    return ber_pdu_content_size(pdu, *varbinds_len);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the length of the value of the message sequence holding a PDU of the given length.
+ * The length of the scoped PDU of an SNMPv3 message is returned separately.
+ */
+static u16t ber_message_content_size(const message_t* const message, const u16t pdu_len, u16t* scoped_len)
 {
-    s32t tmp;
     u16t len;
-    /* write in the reverse order */
+#if ENABLE_SNMPv3
+    u16t global_len, usm_len;
+    if (message->version == SNMP_VERSION_3) {
+        *scoped_len = ber_string_size(message->v3.context_engine_id_len) + ber_string_size(message->v3.context_name_len) +
+                1 + ber_length_size(pdu_len) + pdu_len;
+        len = 1 + ber_length_size(*scoped_len) + *scoped_len;
+        if (message->v3.msg_flags & SNMP_MSG_FLAG_PRIV) {
+            /* the scoped PDU is encrypted in place into an octet string */
+            len = ber_string_size(len);
+        }
+        return len + ber_v3_header_size(&message->v3, &global_len, &usm_len);
+    }
+#endif /* ENABLE_SNMPv3 */
+    *scoped_len = 0;
+    len = 2 + ber_integer_size(message->version) +
+            1 + ber_length_size(message->community_len) + message->community_len +
+            1 + ber_length_size(pdu_len) + pdu_len;
+    return len;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encode SNMP PDU
+ */
+s8t ber_encode_pdu(u8t* output, u16t* pos, const u16t max_len, const u8t* const input, u16t input_len, const pdu_t* const pdu)
+{
+    u16t varbinds_len, len = ber_pdu_size(input_len, pdu, &varbinds_len);
+
+    /* sequence header, a report is the only other PDU sent in reply to a request */
+    TRY(ber_encode_type_length(output, pos, max_len,
+            pdu->request_type == BER_TYPE_SNMP_REPORT ? BER_TYPE_SNMP_REPORT : BER_TYPE_SNMP_RESPONSE, len));
+    CHECK_SPACE(pos, len, max_len);
+
+    /* request id */
+    TRY(ber_encode_integer(output, pos, max_len, pdu->request_id));
+    /* error status */
+    TRY(ber_encode_integer(output, pos, max_len, pdu->error_status));
+    /* error index */
+    TRY(ber_encode_integer(output, pos, max_len, pdu->error_index));
 
-    if (pdu->error_status == ERROR_STATUS_NO_ERROR) {
+    if (!BER_PDU_COPIES_VAR_BINDS(pdu)) {
         /* variable binding list */
         varbind_t* ptr = pdu->varbind_first_ptr;
+        TRY(ber_encode_type_length(output, pos, max_len, BER_TYPE_SEQUENCE, varbinds_len));
         while (ptr) {
-            TRY(ber_encode_var_bind(output, pos, ptr));
+            TRY(ber_encode_var_bind(output, pos, max_len, ptr));
             ptr = ptr->next_ptr;
         }
-        u16t len = max_output_len - *pos;
-        TRY(ber_encode_type_length(output, pos, BER_TYPE_SEQUENCE, len));
     } else {
-        DECN(pos, (input_len - pdu->varbind_index));
-        memcpy(&output[*pos], &input[pdu->varbind_index], input_len - pdu->varbind_index);
+        memcpy(&output[*pos], &input[pdu->varbind_index], varbinds_len);
+        *pos = *pos + varbinds_len;
     }
+    return 0;
+}
 
-    /* error index */
-    tmp = pdu->error_index;
-    TRY(ber_encode_integer(output, pos, tmp));
-    /* error status */
-    tmp = pdu->error_status;
-    TRY(ber_encode_integer(output, pos, tmp));
-    /* request id */
-    TRY(ber_encode_integer(output, pos, pdu->request_id));
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encode an SNMP response in BER.
+ * The lengths of all the fields are computed in advance, so the response is written
+ * from the beginning of the output buffer in a single pass.
+ */
+s8t ber_encode_response(message_t* message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len)
+{
+    u16t varbinds_len, len, scoped_len;
+    u16t pos = 0;
+
+    len = ber_message_content_size(message, ber_pdu_size(input_len, &message->pdu, &varbinds_len), &scoped_len);
 
     /* sequence header*/
-    len = max_output_len - *pos;
-    TRY(ber_encode_type_length(output, pos, BER_TYPE_SNMP_RESPONSE, len));
+    TRY(ber_encode_type_length(output, &pos, max_output_len, BER_TYPE_SEQUENCE, len));
+    CHECK_SPACE(&pos, len, max_output_len);
+
+#if ENABLE_SNMPv3
+    if (message->version == SNMP_VERSION_3) {
+        /* header and security parameters followed by the scoped PDU */
+        TRY(ber_encode_v3_header(output, &pos, max_output_len, &message->v3));
+        if (message->v3.msg_flags & SNMP_MSG_FLAG_PRIV) {
+            TRY(ber_encode_type_length(output, &pos, max_output_len, BER_TYPE_OCTET_STRING, 1 + ber_length_size(scoped_len) + scoped_len));
+        }
+        message->v3.scoped_pdu_pos = pos;
+        TRY(ber_encode_type_length(output, &pos, max_output_len, BER_TYPE_SEQUENCE, scoped_len));
+        TRY(ber_encode_fixed_string(output, &pos, max_output_len, message->v3.context_engine_id, message->v3.context_engine_id_len));
+        TRY(ber_encode_fixed_string(output, &pos, max_output_len, message->v3.context_name, message->v3.context_name_len));
+    } else
+#endif /* ENABLE_SNMPv3 */
+    {
+        /* version */
+        TRY(ber_encode_integer(output, &pos, max_output_len, message->version));
+        /* community string */
+        TRY(ber_encode_fixed_string(output, &pos, max_output_len, message->community, message->community_len));
+    }
+    /* pdu */
+    TRY(ber_encode_pdu(output, &pos, max_output_len, input, input_len, &message->pdu));
 
+    *output_len = pos;
     return 0;
 }
 
+/* number of the length fields a stream reserves: message, encrypted scoped PDU, scoped PDU, PDU and variable bindings */
+#define BER_STREAM_LENGTHS 5
+
 /*-----------------------------------------------------------------------------------*/
 /*
- * Encode an SNMP response in BER
+ * Write a type and a two bytes long length field to be filled in by ber_stream_finish.
  */
-s8t ber_encode_response(const message_t* const message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len)
+static s8t ber_stream_reserve_length(ber_stream_t* stream, u8t type, u16t* len_pos)
 {
-    s32t tmp;
-    s16t pos = max_output_len;
-    ber_encode_pdu(output, &pos, input, input_len, &message->pdu, max_output_len);
+    CHECK_SPACE(&stream->len, 4, stream->max_len);
+    stream->output[stream->len] = type;
+    stream->output[stream->len + 1] = 0x82;
+    *len_pos = stream->len + 2;
+    stream->len += 4;
+    return 0;
+}
 
-    /* community string */
-    TRY(ber_encode_string(output, &pos, message->community));
-    /* version */
-    tmp = message->version;
-    TRY(ber_encode_integer(output, &pos, tmp));
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Start encoding a message of the given PDU type which variable bindings are appended one by one.
+ * The lengths of the enclosing sequences are not known in advance, so room for the two bytes
+ * long form is reserved and ber_stream_finish shortens them.
+ */
+s8t ber_stream_start(ber_stream_t* stream, message_t* message, const u8t pdu_type, u8t* output, const u16t max_output_len)
+{
+    u16t len_pos;
+    stream->output = output;
+    stream->start = 0;
+    stream->len = 0;
+    stream->size = max_output_len;
+    stream->max_len = max_output_len;
+    stream->encrypted_len_pos = 0;
+    stream->scoped_pdu_len_pos = 0;
+#if ENABLE_SNMPv3
+    stream->v3 = (message->version == SNMP_VERSION_3) ? &message->v3 : 0;
+#endif /* ENABLE_SNMPv3 */
+
+    /* sequence header */
+    TRY(ber_stream_reserve_length(stream, BER_TYPE_SEQUENCE, &len_pos));
+
+#if ENABLE_SNMPv3
+    if (message->version == SNMP_VERSION_3) {
+        /* header and security parameters followed by the scoped PDU */
+        TRY(ber_encode_v3_header(output, &stream->len, stream->max_len, &message->v3));
+        if (message->v3.msg_flags & SNMP_MSG_FLAG_PRIV) {
+            TRY(ber_stream_reserve_length(stream, BER_TYPE_OCTET_STRING, &stream->encrypted_len_pos));
+        }
+        message->v3.scoped_pdu_pos = stream->len;
+        TRY(ber_stream_reserve_length(stream, BER_TYPE_SEQUENCE, &stream->scoped_pdu_len_pos));
+        TRY(ber_encode_fixed_string(output, &stream->len, stream->max_len, message->v3.context_engine_id, message->v3.context_engine_id_len));
+        TRY(ber_encode_fixed_string(output, &stream->len, stream->max_len, message->v3.context_name, message->v3.context_name_len));
+    } else
+#endif /* ENABLE_SNMPv3 */
+    {
+        /* version */
+        TRY(ber_encode_integer(output, &stream->len, stream->max_len, message->version));
+
+        /* community string */
+        TRY(ber_encode_fixed_string(output, &stream->len, stream->max_len, message->community, message->community_len));
+    }
 
-    /* sequence header*/
-    u16t len = max_output_len - pos;
-    TRY(ber_encode_type_length(output, &pos, BER_TYPE_SEQUENCE, len));
+    /* pdu header */
+    TRY(ber_stream_reserve_length(stream, pdu_type, &stream->pdu_len_pos));
+
+    /* request id, error status and error index */
+    TRY(ber_encode_integer(output, &stream->len, stream->max_len, message->pdu.request_id));
+    TRY(ber_encode_integer(output, &stream->len, stream->max_len, message->pdu.error_status));
+    TRY(ber_encode_integer(output, &stream->len, stream->max_len, message->pdu.error_index));
 
-    *output_len = max_output_len - pos;
-    if (pos > 0) {
-        memmove(output, output + pos, *output_len);
+    /* variable binding list header */
+    TRY(ber_stream_reserve_length(stream, BER_TYPE_SEQUENCE, &stream->varbinds_len_pos));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the positions of the reserved length fields the message has, in their order, the lengths
+ * they are filled in with and the number of bytes of their shortest forms.
+ * Returns the number of the fields, the first one is the one of the message sequence.
+ */
+static u8t ber_stream_lengths(const ber_stream_t* stream, u16t* len_pos, u16t* len, u8t* len_size)
+{
+    u16t fields[BER_STREAM_LENGTHS] = {2, stream->encrypted_len_pos, stream->scoped_pdu_len_pos, stream->pdu_len_pos, stream->varbinds_len_pos};
+    u16t shortened = 0;
+    u8t i, count = 0;
+
+    for (i = 0; i < BER_STREAM_LENGTHS; i++) {
+        /* there is no scoped PDU in a community based message and no encrypted one without privacy */
+        if (fields[i]) {
+            len_pos[count++] = fields[i];
+        }
+    }
+    if (count < BER_STREAM_LENGTHS) {
+        len_pos[count] = 0;
+    }
+
+    /* the reserved field takes 3 bytes starting with 0x82 before len_pos, the value follows it */
+    for (i = count; i-- > 0; ) {
+        len[i] = stream->len - len_pos[i] - 2 - shortened;
+        len_size[i] = ber_length_size(len[i]);
+        shortened += 3 - len_size[i];
+    }
+    return count;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append a variable binding to the response.
+ * Returns -1 and leaves the stream untouched if the variable binding does not fit.
+ */
+s8t ber_stream_append(ber_stream_t* stream, const varbind_t* const varbind)
+{
+    u16t len_pos[BER_STREAM_LENGTHS], len[BER_STREAM_LENGTHS];
+    u8t len_size[BER_STREAM_LENGTHS];
+    u16t prev_len = stream->len;
+
+    TRY(ber_encode_var_bind(stream->output, &stream->len, stream->size, varbind));
+    /* the fit is checked against the length of the message once its length fields are shortened */
+    ber_stream_lengths(stream, len_pos, len, len_size);
+    if (1 + len_size[0] + len[0] > stream->max_len) {
+        stream->len = prev_len;
+        return -1;
     }
     return 0;
 }
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the position a byte of the stream moves to, from the start of the message, when the reserved
+ * length fields before it are shortened.
+ */
+static u16t ber_stream_moved(const u16t* len_pos, const u8t* len_size, u16t pos)
+{
+    u16t moved = pos;
+    u8t i;
+    for (i = 0; i < BER_STREAM_LENGTHS && len_pos[i] && len_pos[i] < pos; i++) {
+        moved -= 3 - len_size[i];
+    }
+    return moved;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Fill in the reserved length fields once all the variable bindings are appended.
+ * The lengths are written in the shortest form from the innermost field outwards and the header
+ * between the fields is moved forward to close the gaps, so the variable bindings stay where they are
+ * and the message starts a few bytes after the beginning of the output.
+ */
+void ber_stream_finish(ber_stream_t* stream)
+{
+    u16t len_pos[BER_STREAM_LENGTHS], len[BER_STREAM_LENGTHS];
+    u8t len_size[BER_STREAM_LENGTHS];
+    u8t i, type, count;
+    u16t end, header_len, pos;
+
+    count = ber_stream_lengths(stream, len_pos, len, len_size);
+
+#if ENABLE_SNMPv3
+    if (stream->v3) {
+        stream->v3->scoped_pdu_pos = ber_stream_moved(len_pos, len_size, stream->v3->scoped_pdu_pos);
+        if (stream->v3->auth_params_pos) {
+            stream->v3->auth_params_pos = ber_stream_moved(len_pos, len_size, stream->v3->auth_params_pos);
+        }
+    }
+#endif /* ENABLE_SNMPv3 */
+
+    /* the value of the innermost field, the variable bindings, is not moved */
+    end = len_pos[count - 1] + 2;
+    for (i = count; i-- > 0; ) {
+        if (i + 1 < count) {
+            header_len = len_pos[i + 1] - len_pos[i] - 4;
+            end -= header_len;
+            memmove(stream->output + end, stream->output + len_pos[i] + 2, header_len);
+        }
+        type = stream->output[len_pos[i] - 2];
+        end -= 1 + len_size[i];
+        stream->output[end] = type;
+        pos = end + 1;
+        ber_encode_length(stream->output, &pos, stream->len, len[i]);
+    }
+    /* the message sequence is the outermost field */
+    stream->start = end;
+    stream->len -= end;
+}
@@ -67,11 +67,54 @@
 #define BER_TYPE_SNMP_REPORT                            0xA8
 
 
+/** \brief State of a message which variable bindings are encoded one by one.
+ * Once the stream is finished, the message takes len bytes starting at output + start. */
+typedef struct {
+    u8t*    output;
+    u16t    start;
+    u16t    len;
+    /* the reserved length fields take a few bytes more than the final ones, so the size of the output
+       is checked while encoding, and the length of the finished message against max_len */
+    u16t    size;
+    u16t    max_len;
+    /* positions of the reserved length fields, the scoped PDU ones are 0 if the message has no such fields */
+    u16t    encrypted_len_pos;
+    u16t    scoped_pdu_len_pos;
+    u16t    pdu_len_pos;
+    u16t    varbinds_len_pos;
+#if ENABLE_SNMPv3
+    /* the positions of the authentication parameters and the scoped PDU move when the lengths are shortened */
+    message_v3_t* v3;
+#endif /* ENABLE_SNMPv3 */
+} ber_stream_t;
+
 /* BER decoding */
 s8t ber_decode_request(const u8t* const input, const u16t len, message_t* request);
 
+/* Decoding of a BER message variable binding by variable binding */
+s8t ber_decode_header(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+
+s8t ber_decode_var_bind(const u8t* const input, const u16t len, u16t* pos, varbind_t* varbind);
+
+s8t ber_decode_var_binds(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+
+#if ENABLE_SNMPv3
+s8t ber_decode_scoped_pdu(const u8t* const input, const u16t len, message_t* request);
+#endif /* ENABLE_SNMPv3 */
+
 /* BER encoding */
-s8t ber_encode_response(const message_t* const message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len);
+u16t ber_var_bind_size(const varbind_t* const varbind);
+
+s8t ber_encode_var_bind(u8t* output, u16t* pos, const u16t max_len, const varbind_t* const varbind);
+
+s8t ber_encode_response(message_t* message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len);
+
+/* Incremental BER encoding of a response or a notification */
+s8t ber_stream_start(ber_stream_t* stream, message_t* message, const u8t pdu_type, u8t* output, const u16t max_output_len);
+
+s8t ber_stream_append(ber_stream_t* stream, const varbind_t* const varbind);
+
+void ber_stream_finish(ber_stream_t* stream);
 
 #endif	/* __BER_H__ */
 
@@ -0,0 +1,603 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Compact encoding of SNMP messages for 6LoWPAN links
+ *
+ *         A BER encoded GET of a single MIB-II scalar takes about 40 bytes, mostly spent on
+ *         the common OID prefix, the version, the community and the length fields. In the
+ *         compact encoding the same request takes 14 bytes, so responses with several
+ *         variable bindings fit into a single 802.15.4 frame. A gateway translates the
+ *         compact messages to BER for standard managers.
+ *
+ *         The message is a header followed by the variable bindings up to the end of the datagram:
+ *
+ *         header          11vv dddd   v - version (0 - SNMPv1, 1 - SNMPv2c), d - OID prefix dictionary
+ *         PDU             00e0 tttt   t - PDU type minus 0xA0, e - error-status and error-index
+ *                                     follow, non-repeaters and max-repetitions always follow
+ *                                     in a GetBulk request
+ *         community       length, bytes, always sent as the message is authenticated by it
+ *         request-id      signed integer
+ *         variable        OID, value type as in BER, value
+ *         OID             pppp llll   p - prefix in the dictionary (0 - no prefix),
+ *                                     l - number of the sub-identifiers following
+ *
+ *         Integers are written in 7 bit groups, the least significant first, with the high bit
+ *         set in all but the last group. Signed integers are zigzag encoded, so small negative
+ *         values stay short. Strings are written as their length followed by their bytes,
+ *         NULL and the exceptions have no value.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#include "compact.h"
+#include "logging.h"
+#include "utils.h"
+
+#define TRACE_FILE 2
+
+#define CHECK_SPACE(pos, len, max_len) if (*(pos) + (len) > (max_len)) { snmp_log("too big message: %d\n", __LINE__); return -1;}
+
+#define TRY(c) { s8t try_ret = (c); if (try_ret < 0) { snmp_log("exception line: %d\n", __LINE__); return try_ret; } }
+
+#define CHECK_PTR_MA(ptr) if (!ptr) { snmp_log("can not allocate memory, line: %d\n", __LINE__); return ERR_MEMORY_ALLOCATION; }
+
+/* flags of the PDU byte */
+#define COMPACT_PDU_TYPE_MASK                           0x0F
+#define COMPACT_FLAG_ERROR                              0x20
+
+/*
+ * OID prefix dictionary, every entry is its length followed by its sub-identifiers.
+ * The entries are numbered from 1 and the list ends with 0.
+ */
+static const u8t dictionary[] = {
+    /* 1 - mib-2 */
+    6, 1, 3, 6, 1, 2, 1,
+    /* 2 - system */
+    7, 1, 3, 6, 1, 2, 1, 1,
+    /* 3 - ifEntry */
+    9, 1, 3, 6, 1, 2, 1, 2, 2, 1,
+    /* 4 - enterprises */
+    6, 1, 3, 6, 1, 4, 1,
+    /* 5 - snmpMIBObjects, sysUpTime and snmpTrapOID of the notifications */
+    8, 1, 3, 6, 1, 6, 3, 1, 1,
+    /* 6 - usmStats */
+    9, 1, 3, 6, 1, 6, 3, 15, 1, 1,
+    /* 7 - internet */
+    4, 1, 3, 6, 1,
+    0
+};
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find a prefix in the dictionary. Returns its length, or 0 if there is no such prefix.
+ */
+static u8t compact_prefix(u8t index, const u8t** prefix)
+{
+    const u8t* ptr = dictionary;
+    while (*ptr && --index) {
+        ptr += *ptr + 1;
+    }
+    *prefix = ptr + 1;
+    return *ptr;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode an unsigned integer.
+ */
+static s8t compact_decode_unsigned(const u8t* const input, const u16t len, u16t* pos, u32t* value)
+{
+    u8t shift = 0;
+    *value = 0;
+    do {
+        if (*pos >= len || shift > 28) {
+            snmp_log("bad integer or unexpected end of the compact message\n");
+            return -1;
+        }
+        *value |= (u32t)(input[*pos] & 0x7F) << shift;
+        shift += 7;
+    } while (input[(*pos)++] & 0x80);
+    *value &= 0xFFFFFFFFUL;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a Counter64 value into the request arena.
+ */
+static s8t compact_decode_unsigned64(const u8t* const input, const u16t len, u16t* pos, u64t** value)
+{
+    u8t shift = 0;
+    *value = arena_alloc(sizeof(u64t));
+    CHECK_PTR_MA(*value);
+    **value = 0;
+    do {
+        if (*pos >= len || shift > 63) {
+            snmp_log("bad integer or unexpected end of the compact message\n");
+            return -1;
+        }
+        **value |= (u64t)(input[*pos] & 0x7F) << shift;
+        shift += 7;
+    } while (input[(*pos)++] & 0x80);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a zigzag encoded signed integer.
+ */
+static s8t compact_decode_integer(const u8t* const input, const u16t len, u16t* pos, s32t* value)
+{
+    u32t tmp;
+    TRY(compact_decode_unsigned(input, len, pos, &tmp));
+    *value = (s32t)(tmp >> 1) ^ -(s32t)(tmp & 1);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a string, the value points into the input.
+ */
+static s8t compact_decode_string(const u8t* const input, const u16t len, u16t* pos, u8t** value, u16t* value_len)
+{
+    u32t tmp;
+    TRY(compact_decode_unsigned(input, len, pos, &tmp));
+    if (tmp > len - *pos) {
+        snmp_log("can't fetch a string: unexpected end of the compact message\n");
+        return -1;
+    }
+    *value = (u8t*)&input[*pos];
+    *value_len = (u16t)tmp;
+    *pos = *pos + *value_len;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode an OID.
+ */
+static s8t compact_decode_oid(const u8t* const input, const u16t len, u16t* pos, oid_t* oid)
+{
+    const u8t* prefix;
+    u8t count, i;
+    u32t tmp;
+
+    if (*pos >= len) {
+        snmp_log("can't fetch an OID: unexpected end of the compact message\n");
+        return -1;
+    }
+    oid->len = (input[*pos] >> 4) ? compact_prefix(input[*pos] >> 4, &prefix) : 0;
+    count = input[*pos] & 0x0F;
+    *pos = *pos + 1;
+    if ((input[*pos - 1] >> 4) && !oid->len) {
+        snmp_log("unknown OID prefix %d\n", input[*pos - 1] >> 4);
+        return -1;
+    }
+    if (oid->len + count > OID_LEN) {
+        snmp_log("too long OID\n");
+        return -1;
+    }
+    for (i = 0; i < oid->len; i++) {
+        oid->values[i] = prefix[i];
+    }
+    for (i = 0; i < count; i++) {
+        TRY(compact_decode_unsigned(input, len, pos, &tmp));
+        if ((OID_T)tmp != tmp) {
+            snmp_log("too big sub-identifier %lu\n", tmp);
+            return -1;
+        }
+        oid->values[oid->len++] = (OID_T)tmp;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a value of the given type.
+ */
+static s8t compact_decode_value(const u8t* const input, const u16t len, u16t* pos, u8t* value_type, varbind_value_t* value)
+{
+    oid_t* oid_ptr;
+    if (*pos >= len) {
+        snmp_log("can't fetch a value: unexpected end of the compact message\n");
+        return -1;
+    }
+    *value_type = input[*pos];
+    *pos = *pos + 1;
+    switch (*value_type) {
+        case BER_TYPE_INTEGER:
+            TRY(compact_decode_integer(input, len, pos, &value->i_value));
+            break;
+        case BER_TYPE_OCTET_STRING:
+            TRY(compact_decode_string(input, len, pos, &value->s_value.ptr, &value->s_value.len));
+            break;
+        case BER_TYPE_COUNTER:
+        case BER_TYPE_GAUGE:
+        case BER_TYPE_TIME_TICKS:
+            TRY(compact_decode_unsigned(input, len, pos, &value->u_value));
+            break;
+        case BER_TYPE_COUNTER64:
+            TRY(compact_decode_unsigned64(input, len, pos, &value->u64_value));
+            break;
+        case BER_TYPE_OID:
+            oid_ptr = oid_create();
+            CHECK_PTR_MA(oid_ptr);
+            TRY(compact_decode_oid(input, len, pos, oid_ptr));
+            value->oid_value = oid_ptr;
+            break;
+        case BER_TYPE_NULL:
+        case BER_TYPE_NO_SUCH_OBJECT:
+        case BER_TYPE_NO_SUCH_INSTANCE:
+        case BER_TYPE_END_OF_MIB_VIEW:
+            break;
+        default:
+            snmp_log("unsupported type %02X\n", *value_type);
+            return -1;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode the header of a compact message up to its variable bindings.
+ */
+s8t compact_decode_header(const u8t* const input, const u16t len, u16t* pos, message_t* request)
+{
+    u8t flags;
+    u32t tmp;
+
+    if (!COMPACT_IS_MESSAGE(input, len) || len < 2) {
+        return -1;
+    }
+    if ((input[0] & 0x0F) != COMPACT_DICTIONARY) {
+        snmp_log("unknown OID prefix dictionary %d\n", input[0] & 0x0F);
+        return -1;
+    }
+    request->version = (input[0] >> 4) & 0x03;
+    if (request->version != SNMP_VERSION_1 && request->version != SNMP_VERSION_2C) {
+        snmp_log("unsupported SNMP version %d\n", request->version);
+        return -1;
+    }
+
+    flags = input[1];
+    *pos = 2;
+    request->pdu.request_type = BER_TYPE_SNMP_GET + (flags & COMPACT_PDU_TYPE_MASK);
+    if (request->pdu.request_type > BER_TYPE_SNMP_REPORT) {
+        snmp_log("unsupported PDU type %02X\n", request->pdu.request_type);
+        return -1;
+    }
+
+    TRY(compact_decode_string(input, len, pos, &request->community, &request->community_len));
+
+    /* request-id, error-status and error-index or non-repeaters and max-repetitions */
+    TRY(compact_decode_integer(input, len, pos, &request->pdu.request_id));
+    if (request->pdu.request_type == BER_TYPE_SNMP_GETBULK) {
+        TRY(compact_decode_unsigned(input, len, pos, &tmp));
+        request->pdu.non_repeaters = (u16t)min(tmp, 0xFFFF);
+        TRY(compact_decode_unsigned(input, len, pos, &tmp));
+        request->pdu.max_repetitions = (u16t)min(tmp, 0xFFFF);
+    } else if (flags & COMPACT_FLAG_ERROR) {
+        TRY(compact_decode_unsigned(input, len, pos, &tmp));
+        request->pdu.error_status = (u8t)tmp;
+        TRY(compact_decode_unsigned(input, len, pos, &tmp));
+        request->pdu.error_index = (u8t)tmp;
+    }
+    request->pdu.varbind_index = *pos;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode a variable binding into the OID the variable binding points to.
+ * Only OID and Counter64 values are allocated in the request arena.
+ */
+s8t compact_decode_var_bind(const u8t* const input, const u16t len, u16t* pos, varbind_t* varbind)
+{
+    TRY(compact_decode_oid(input, len, pos, varbind->oid_ptr));
+    TRY(compact_decode_value(input, len, pos, &varbind->value_type, &varbind->value));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decode the variable bindings from the position up to the end of the message into a list.
+ */
+s8t compact_decode_var_binds(const u8t* const input, const u16t len, u16t* pos, message_t* request)
+{
+    varbind_t* cur_ptr = 0;
+    request->pdu.varbind_len = 0;
+    request->pdu.varbind_first_ptr = 0;
+    while (*pos < len) {
+        cur_ptr = varbind_list_append(cur_ptr);
+        if (!cur_ptr) {
+            return ERR_MEMORY_ALLOCATION;
+        }
+        if (!request->pdu.varbind_first_ptr) {
+            request->pdu.varbind_first_ptr = cur_ptr;
+        }
+        cur_ptr->oid_ptr = oid_create();
+        CHECK_PTR_MA(cur_ptr->oid_ptr);
+        TRY(compact_decode_var_bind(input, len, pos, cur_ptr));
+        request->pdu.varbind_len++;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Parse a compact SNMP message.
+ */
+s8t compact_decode_request(const u8t* const input, const u16t len, message_t* request)
+{
+    u16t pos;
+    TRY(compact_decode_header(input, len, &pos, request));
+    TRY(compact_decode_var_binds(input, len, &pos, request));
+    snmp_log("parsing finished: OK\n");
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Zigzag encode a signed integer.
+ */
+static u32t compact_zigzag(const s32t value)
+{
+    return ((u32t)value << 1) ^ (value < 0 ? 0xFFFFFFFFUL : 0);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find the longest prefix of the dictionary the OID starts with, 0 if there is none.
+ */
+static u8t compact_oid_prefix(const oid_t* const oid, u8t* best_len)
+{
+    const u8t* prefix;
+    u8t index, prefix_len, best = 0, i;
+
+    *best_len = 0;
+    for (index = 1; (prefix_len = compact_prefix(index, &prefix)) != 0; index++) {
+        if (prefix_len > *best_len && prefix_len <= oid->len) {
+            for (i = 0; i < prefix_len && oid->values[i] == prefix[i]; i++);
+            if (i == prefix_len) {
+                best = index;
+                *best_len = prefix_len;
+            }
+        }
+    }
+    return best;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write an unsigned integer.
+ */
+static s8t compact_encode_unsigned(u8t* output, u16t* pos, const u16t max_len, u32t value)
+{
+    value &= 0xFFFFFFFFUL;
+    do {
+        CHECK_SPACE(pos, 1, max_len);
+        output[*pos] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0x00);
+        *pos = *pos + 1;
+        value >>= 7;
+    } while (value);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a Counter64 value.
+ */
+static s8t compact_encode_unsigned64(u8t* output, u16t* pos, const u16t max_len, u64t value)
+{
+    do {
+        CHECK_SPACE(pos, 1, max_len);
+        output[*pos] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0x00);
+        *pos = *pos + 1;
+        value >>= 7;
+    } while (value);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a zigzag encoded signed integer.
+ */
+static s8t compact_encode_integer(u8t* output, u16t* pos, const u16t max_len, const s32t value)
+{
+    return compact_encode_unsigned(output, pos, max_len, compact_zigzag(value));
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a string.
+ */
+static s8t compact_encode_string(u8t* output, u16t* pos, const u16t max_len, const u8t* const value, const u16t len)
+{
+    TRY(compact_encode_unsigned(output, pos, max_len, len));
+    CHECK_SPACE(pos, len, max_len);
+    if (len) {
+        memcpy(output + *pos, value, len);
+    }
+    *pos = *pos + len;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write an OID using the longest prefix of the dictionary it starts with.
+ */
+static s8t compact_encode_oid(u8t* output, u16t* pos, const u16t max_len, const oid_t* const oid)
+{
+    u8t best_len, i;
+    u8t best = compact_oid_prefix(oid, &best_len);
+
+    CHECK_SPACE(pos, 1, max_len);
+    output[*pos] = (best << 4) | (oid->len - best_len);
+    *pos = *pos + 1;
+    for (i = best_len; i < oid->len; i++) {
+        TRY(compact_encode_unsigned(output, pos, max_len, oid->values[i]));
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write a variable binding. The BER encoding cached in the variable binding is not used.
+ */
+static s8t compact_encode_var_bind(u8t* output, u16t* pos, const u16t max_len, const varbind_t* const varbind)
+{
+    TRY(compact_encode_oid(output, pos, max_len, varbind->oid_ptr));
+    CHECK_SPACE(pos, 1, max_len);
+    output[*pos] = varbind->value_type;
+    *pos = *pos + 1;
+    switch (varbind->value_type) {
+        case BER_TYPE_INTEGER:
+            TRY(compact_encode_integer(output, pos, max_len, varbind->value.i_value));
+            break;
+        case BER_TYPE_OCTET_STRING:
+            TRY(compact_encode_string(output, pos, max_len, varbind->value.s_value.ptr, varbind->value.s_value.len));
+            break;
+        case BER_TYPE_COUNTER:
+        case BER_TYPE_GAUGE:
+        case BER_TYPE_TIME_TICKS:
+            TRY(compact_encode_unsigned(output, pos, max_len, varbind->value.u_value));
+            break;
+        case BER_TYPE_COUNTER64:
+            TRY(compact_encode_unsigned64(output, pos, max_len, VARBIND_U64(varbind->value)));
+            break;
+        case BER_TYPE_OID:
+            TRY(compact_encode_oid(output, pos, max_len, varbind->value.oid_value));
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the PDU byte of a message.
+ */
+static u8t compact_header_flags(const message_t* const message, const u8t pdu_type)
+{
+    u8t flags = pdu_type - BER_TYPE_SNMP_GET;
+    if (pdu_type != BER_TYPE_SNMP_GETBULK && (message->pdu.error_status || message->pdu.error_index)) {
+        flags |= COMPACT_FLAG_ERROR;
+    }
+    return flags;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Write the header of a message up to its variable bindings.
+ */
+static s8t compact_encode_header(u8t* output, u16t* pos, const u16t max_len, const message_t* const message, const u8t pdu_type)
+{
+    u8t flags = compact_header_flags(message, pdu_type);
+
+    if (message->version != SNMP_VERSION_1 && message->version != SNMP_VERSION_2C) {
+        snmp_log("SNMP version %d can't be encoded compactly\n", message->version);
+        return -1;
+    }
+
+    CHECK_SPACE(pos, 2, max_len);
+    output[*pos] = COMPACT_HEADER | (message->version << 4) | COMPACT_DICTIONARY;
+    output[*pos + 1] = flags;
+    *pos = *pos + 2;
+
+    TRY(compact_encode_string(output, pos, max_len, message->community, message->community_len));
+    TRY(compact_encode_integer(output, pos, max_len, message->pdu.request_id));
+    if (pdu_type == BER_TYPE_SNMP_GETBULK) {
+        TRY(compact_encode_unsigned(output, pos, max_len, message->pdu.non_repeaters));
+        TRY(compact_encode_unsigned(output, pos, max_len, message->pdu.max_repetitions));
+    } else if (flags & COMPACT_FLAG_ERROR) {
+        TRY(compact_encode_unsigned(output, pos, max_len, message->pdu.error_status));
+        TRY(compact_encode_unsigned(output, pos, max_len, message->pdu.error_index));
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encode an SNMP response compactly.
+ * If there is an error, the variable bindings of the compact request are copied as they are,
+ * unless the request has none to copy, see pdu_t.
+ */
+s8t compact_encode_response(message_t* message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len)
+{
+    u16t pos = 0;
+    varbind_t* ptr;
+
+    TRY(compact_encode_header(output, &pos, max_output_len, message, BER_TYPE_SNMP_RESPONSE));
+    if (message->pdu.error_status == ERROR_STATUS_NO_ERROR || !message->pdu.varbind_index) {
+        for (ptr = message->pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr) {
+            TRY(compact_encode_var_bind(output, &pos, max_output_len, ptr));
+        }
+    } else {
+        CHECK_SPACE(&pos, input_len - message->pdu.varbind_index, max_output_len);
+        memcpy(output + pos, input + message->pdu.varbind_index, input_len - message->pdu.varbind_index);
+        pos = pos + input_len - message->pdu.varbind_index;
+    }
+    *output_len = pos;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Start encoding a message of the given PDU type which variable bindings are appended one by one.
+ * There are no length fields to reserve, so only the output buffer is kept in the stream.
+ */
+s8t compact_stream_start(ber_stream_t* stream, message_t* message, const u8t pdu_type, u8t* output, const u16t max_output_len)
+{
+    stream->output = output;
+    stream->start = 0;
+    stream->len = 0;
+    stream->size = max_output_len;
+    stream->max_len = max_output_len;
+    return compact_encode_header(output, &stream->len, max_output_len, message, pdu_type);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append a variable binding to the message.
+ * Returns -1 and leaves the stream untouched if the variable binding does not fit.
+ */
+s8t compact_stream_append(ber_stream_t* stream, const varbind_t* const varbind)
+{
+    u16t len = stream->len;
+    if (compact_encode_var_bind(stream->output, &len, stream->max_len, varbind) == -1) {
+        return -1;
+    }
+    stream->len = len;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Finish the message, the end of the variable bindings is the end of the datagram.
+ */
+void compact_stream_finish(ber_stream_t* stream)
+{
+}
@@ -0,0 +1,64 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Compact encoding of SNMP messages for 6LoWPAN links
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __COMPACT_H__
+#define	__COMPACT_H__
+
+#include "snmp.h"
+#include "ber.h"
+
+/* the two upper bits of the first byte of a compact message, a BER encoded one starts with a sequence */
+#define COMPACT_HEADER                                  0xC0
+#define COMPACT_HEADER_MASK                             0xC0
+
+/* identifier of the OID prefix dictionary, messages using another one are discarded */
+#define COMPACT_DICTIONARY                              1
+
+#define COMPACT_IS_MESSAGE(input, len)  ((len) > 0 && ((input)[0] & COMPACT_HEADER_MASK) == COMPACT_HEADER)
+
+/* Compact decoding */
+s8t compact_decode_request(const u8t* const input, const u16t len, message_t* request);
+
+/* Decoding of a compact message variable binding by variable binding */
+s8t compact_decode_header(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+
+s8t compact_decode_var_bind(const u8t* const input, const u16t len, u16t* pos, varbind_t* varbind);
+
+s8t compact_decode_var_binds(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+
+/* Compact encoding */
+s8t compact_encode_response(message_t* message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len);
+
+/* Incremental compact encoding of a message, the state is kept in a BER stream */
+s8t compact_stream_start(ber_stream_t* stream, message_t* message, const u8t pdu_type, u8t* output, const u16t max_output_len);
+
+s8t compact_stream_append(ber_stream_t* stream, const varbind_t* const varbind);
+
+void compact_stream_finish(ber_stream_t* stream);
+
+#endif	/* __COMPACT_H__ */
@@ -21,106 +21,107 @@
 
 /**
  * \file
- *         UDP implementatio of logging facilites for the SNMP server
+ *         Ring buffer of the trace records of the log points
  * \author
  *         Siarhei Kuryla <kurilo@gmail.com>
  */
-#include "logging.h"
 
-#if DEBUG
-#include <stdio.h>
 #include <stdarg.h>
-#include <string.h>
 
-/** \brief length of the buffer used for debugging messages */
-#define BUF_LEN 100
+#include "logging.h"
+
+#if DEBUG || INFO
 
-#if !CONTIKI_TARGET_MINIMAL_NET 
-#include "contiki-net.h"
+#define RECORD_LEN(flags) (4 + 4 * ((flags) & 0x03))
 
-/** \brief port number where debug messages are sent */
-#define LOGGING_PORT 12345
+static u8t trace_buf[TRACE_BUF_SIZE];
+/* the index of the oldest record and the number of the bytes taken */
+static u16t trace_start = 0;
+static u16t trace_len = 0;
+/* the number of the records overwritten since the last batch */
+static u16t trace_lost = 0;
 
-/*--------------------------------------------------------------------------*/
+/*-----------------------------------------------------------------------------------*/
 /*
- * Log a debug message by sending it within a UDP message.
+ * Get a byte of the buffer counted from the oldest record.
  */
-void snmp_log(char* format, ...)
-{  
-    static struct uip_udp_conn *udp_con = NULL;
-    if (udp_con == NULL) {
-        udp_con = udp_new(NULL, HTONS(LOGGING_PORT), NULL);
-        uip_ip6addr(&udp_con->ripaddr, 0xaaaa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001);
-	udp_bind(udp_con, HTONS(3000));
-    }
-    
-    va_list args;
-    va_start(args, format);
-    static char buf[BUF_LEN];
-    memset(buf, 0, BUF_LEN);
-    vsprintf(buf, format, args);
-    va_end(args);
-
-    uip_udp_packet_send(udp_con, buf, strlen(buf));
+static u8t trace_byte(u16t i)
+{
+    return trace_buf[(trace_start + i) % TRACE_BUF_SIZE];
 }
-#else
 
-void snmp_log(char* format, ... )
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append a byte to the buffer.
+ */
+static void trace_put(u8t value)
 {
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
+    trace_buf[(trace_start + trace_len) % TRACE_BUF_SIZE] = value;
+    trace_len++;
 }
-#endif /* CONTIKI_TARGET_MINIMAL_NET */
-#endif /* DEBUG */
-
-
-#if INFO
-#include <stdio.h>
-#include <stdarg.h>
-#include <string.h>
-
-/** \brief length of the buffer used for debugging messages */
-#define BUF_LEN 100
 
-#if !CONTIKI_TARGET_MINIMAL_NET
-#include "contiki-net.h"
-
-/** \brief port number where debug messages are sent */
-#define LOGGING_PORT 12345
-
-/*--------------------------------------------------------------------------*/
+/*-----------------------------------------------------------------------------------*/
 /*
- * Log a debug message by sending it within a UDP message.
+ * Record a log point, the oldest records are overwritten if the buffer is full.
  */
-void snmp_info(char* format, ...)
+void trace_record(const u8t file, const u16t line, const u8t flags, ...)
 {
-    static struct uip_udp_conn *udp_con = NULL;
-    if (udp_con == NULL) {
-        udp_con = udp_new(NULL, HTONS(LOGGING_PORT), NULL);
-        uip_ip6addr(&udp_con->ripaddr, 0xaaaa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001);
-	udp_bind(udp_con, HTONS(3000));
+    u8t i, len = RECORD_LEN(flags);
+    u32t value;
+    va_list args;
+
+    while (trace_len + len > TRACE_BUF_SIZE) {
+        i = RECORD_LEN(trace_byte(3));
+        trace_start = (trace_start + i) % TRACE_BUF_SIZE;
+        trace_len -= i;
+        if (trace_lost < 0xFFFF) {
+            trace_lost++;
+        }
     }
 
-    va_list args;
-    va_start(args, format);
-    static char buf[BUF_LEN];
-    memset(buf, 0, BUF_LEN);
-    vsprintf(buf, format, args);
+    trace_put(file);
+    trace_put(line >> 8);
+    trace_put(line & 0xFF);
+    trace_put(flags);
+    va_start(args, flags);
+    for (i = 0; i < (flags & 0x03); i++) {
+        value = (u32t)va_arg(args, s32t);
+        trace_put((value >> 24) & 0xFF);
+        trace_put((value >> 16) & 0xFF);
+        trace_put((value >> 8) & 0xFF);
+        trace_put(value & 0xFF);
+    }
     va_end(args);
-
-    uip_udp_packet_send(udp_con, buf, strlen(buf));
 }
-#else
 
-void snmp_info(char* format, ... )
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Move the oldest records which fit into the output to a batch.
+ */
+u16t trace_drain(u8t* output, const u16t max_len)
 {
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
+    u16t i, len = 0;
+    if (!trace_len || max_len < TRACE_HEADER_LEN) {
+        return 0;
+    }
+    while (len < trace_len && TRACE_HEADER_LEN + len + RECORD_LEN(trace_byte(len + 3)) <= max_len) {
+        len += RECORD_LEN(trace_byte(len + 3));
+    }
+    if (!len) {
+        return 0;
+    }
+    output[0] = TRACE_HEADER;
+    output[1] = trace_lost >> 8;
+    output[2] = trace_lost & 0xFF;
+    output[3] = len >> 8;
+    output[4] = len & 0xFF;
+    for (i = 0; i < len; i++) {
+        output[TRACE_HEADER_LEN + i] = trace_byte(i);
+    }
+    trace_start = (trace_start + len) % TRACE_BUF_SIZE;
+    trace_len -= len;
+    trace_lost = 0;
+    return TRACE_HEADER_LEN + len;
 }
 
-#endif /* CONTIKI_TARGET_MINIMAL_NET */
-#endif /* INFO */
\ No newline at end of file
+#endif /* DEBUG || INFO */
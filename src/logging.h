@@ -22,6 +22,23 @@
 /**
  * \file
  *         Logging facilites for the SNMP server
+ *
+ *         A log point does not format its message, it records the identifier of its
+ *         source file (TRACE_FILE defined in the file), its line and up to TRACE_ARGS
+ *         integer arguments in a ring buffer. The buffer is drained in batches and
+ *         tools/tracedump.py turns the records back into the messages using the format
+ *         strings in the sources, which are not compiled into the agent. String arguments
+ *         are not recorded.
+ *
+ *         A batch is 'T', the number of records overwritten before they were drained and
+ *         the length of the records (both 16 bits), followed by the records:
+ *
+ *         file            8 bits
+ *         line            16 bits
+ *         flags           l000 00aa   l - snmp_info, a - number of the arguments
+ *         arguments       32 bits each
+ *
+ *         All the numbers are in the network byte order.
  * \author
  *         Siarhei Kuryla <kurilo@gmail.com>
  */
@@ -29,42 +46,67 @@
 #ifndef __SNMPD_LOGGING_H__
 #define __SNMPD_LOGGING_H__
 
+#include "snmp.h"
+
 /** \brief indicates whether debug is enabled */
-#define DEBUG 0
+#define DEBUG 1
 
 /** \brief indicates whether info messages are enabled */
 #define INFO 1
 
+/** \brief maximum number of the arguments recorded by a log point */
+#define TRACE_ARGS 3
+
+#define TRACE_HEADER            'T'
+#define TRACE_HEADER_LEN        5
+#define TRACE_FLAG_INFO         0x80
+
+#if DEBUG || INFO
+void trace_record(const u8t file, const u16t line, const u8t flags, ...);
+
+/* Moves the oldest records to the output as a batch, returns its length or 0 if there are no records. */
+u16t trace_drain(u8t* output, const u16t max_len);
+#else
+#define trace_drain(output, max_len) 0
+#endif /* DEBUG || INFO */
+
+/* the number of the arguments following the format, the arguments cast to 32 bits */
+#define TRACE_NARGS(...) TRACE_NARGS_(__VA_ARGS__, 3, 2, 1, 0)
+#define TRACE_NARGS_(format, a1, a2, a3, n, ...) n
+#define TRACE_CAT(a, b) TRACE_CAT_(a, b)
+#define TRACE_CAT_(a, b) a##b
+#define TRACE_ARGS_0(format)
+#define TRACE_ARGS_1(format, a1) , (s32t)(a1)
+#define TRACE_ARGS_2(format, a1, a2) , (s32t)(a1), (s32t)(a2)
+#define TRACE_ARGS_3(format, a1, a2, a3) , (s32t)(a1), (s32t)(a2), (s32t)(a3)
+
+#define TRACE(flags, ...) trace_record(TRACE_FILE, __LINE__, (flags) | TRACE_NARGS(__VA_ARGS__) \
+        TRACE_CAT(TRACE_ARGS_, TRACE_NARGS(__VA_ARGS__))(__VA_ARGS__))
 
 #if DEBUG
 /**
  * Log a message.
  *
- * \param m A pointer to a string containing a message.
- *
- * \sa log()
+ * \param format A format string followed by up to TRACE_ARGS integers.
  *
  * \hideinitializer
  */
-void snmp_log(char* format, ...);
+#define snmp_log(...) TRACE(0, __VA_ARGS__)
 #else
 #define snmp_log(...)
 #endif /* DEBUG */
 
 #if INFO
 /**
- * Log a message.
- *
- * \param m A pointer to a string containing a message.
+ * Log an info message.
  *
- * \sa log()
+ * \param format A format string followed by up to TRACE_ARGS integers.
  *
  * \hideinitializer
  */
-void snmp_info(char* format, ...);
+#define snmp_info(...) TRACE(TRACE_FLAG_INFO, __VA_ARGS__)
 #else
 #define snmp_info(...)
 #endif /* INFO */
 
-
-#endif /* __SNMPD_LOGGING_H__ */
\ No newline at end of file
+#endif /* __SNMPD_LOGGING_H__ */
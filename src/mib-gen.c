@@ -0,0 +1,143 @@
+/*
+ * MIB generated by tools/mibgen.py from mib.def, do not edit.
+ */
+#include "mib.h"
+#include "ber.h"
+
+#if MIB_GENERATED_LEN < 9
+#error "MIB_GENERATED_LEN in snmpd-conf.h is less than the 9 generated objects"
+#endif
+
+s8t getIf(mib_object_t* object, OID_T* oid, u8t len);
+s8t getIfNumber(mib_object_t* object, OID_T* oid, u8t len);
+s8t getNextIfOid(mib_object_t* object, OID_T* oid, u8t* len, u8t max_len);
+s8t getSysDescr(mib_object_t* object, OID_T* oid, u8t len);
+s8t getTimeTicks(mib_object_t* object, OID_T* oid, u8t len);
+s8t setSysDescr(mib_object_t* object, OID_T* oid, u8t len, u8t phase, u8t value_type, varbind_value_t value);
+
+static const oid_t oid_0 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1, 1, 0}, 9};
+static const oid_t oid_1 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1, 3, 0}, 9};
+static const oid_t oid_2 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1, 11, 0}, 9};
+static const oid_t oid_3 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1, 13, 0}, 9};
+static const oid_t oid_4 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 2, 1, 0}, 9};
+static const oid_t oid_5 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 2, 2, 1}, 9};
+static const oid_t oid_6 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1234, 1, 0}, 9};
+static const oid_t oid_7 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1234, 2, 0}, 9};
+static const oid_t oid_8 MIB_PROGMEM = {{1, 3, 6, 1, 2, 1, 1234, 3, 0}, 9};
+
+static u64t value_8 = 1311768467463790320ULL;
+
+static const u8t encoded_2[] MIB_PROGMEM = {0x30, 0x1f, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x0b, 0x00, 0x04, 0x13, 0x50, 0x6f, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x20, 0x74, 0x6f, 0x20, 0x61, 0x20, 0x73, 0x74, 0x72, 0x69, 0x6e, 0x67};
+static const u8t encoded_3[] MIB_PROGMEM = {0x30, 0x0f, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x0d, 0x00, 0x43, 0x03, 0xbc, 0x61, 0x4e};
+static const u8t encoded_6[] MIB_PROGMEM = {0x30, 0x0e, 0x06, 0x09, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x89, 0x52, 0x01, 0x00, 0x02, 0x01, 0x00};
+static const u8t encoded_7[] MIB_PROGMEM = {0x30, 0x0e, 0x06, 0x09, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x89, 0x52, 0x02, 0x00, 0x42, 0x01, 0x00};
+static const u8t encoded_8[] MIB_PROGMEM = {0x30, 0x15, 0x06, 0x09, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x89, 0x52, 0x03, 0x00, 0x46, 0x08, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0};
+
+static mib_object_t objects[] = {
+    /* 1.3.6.1.2.1.1.1.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_0,
+            .value_type = BER_TYPE_OCTET_STRING,
+        },
+        .get_fnc_ptr = &getSysDescr,
+        .set_fnc_ptr = &setSysDescr,
+        .flags = MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1.3.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_1,
+            .value_type = BER_TYPE_TIME_TICKS,
+        },
+        .get_fnc_ptr = &getTimeTicks,
+        .flags = MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1.11.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_2,
+            .value_type = BER_TYPE_OCTET_STRING,
+            .value.s_value = {(u8t*)"Pointer to a string", 19},
+            .encoded_ptr = encoded_2,
+            .encoded_len = 33,
+            .encoded_pgm = 1,
+        },
+        .flags = MIB_STATIC_VALUE | MIB_STATIC_ENCODING | MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1.13.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_3,
+            .value_type = BER_TYPE_TIME_TICKS,
+            .value.u_value = 12345678UL,
+            .encoded_ptr = encoded_3,
+            .encoded_len = 17,
+            .encoded_pgm = 1,
+        },
+        .flags = MIB_STATIC_ENCODING | MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.2.1.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_4,
+            .value_type = BER_TYPE_INTEGER,
+        },
+        .get_fnc_ptr = &getIfNumber,
+        .flags = MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.2.2.1 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_5,
+            .value_type = BER_TYPE_NULL,
+        },
+        .get_fnc_ptr = &getIf,
+        .get_next_oid_fnc_ptr = &getNextIfOid,
+        .flags = MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1234.1.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_6,
+            .value_type = BER_TYPE_INTEGER,
+            .encoded_ptr = encoded_6,
+            .encoded_len = 16,
+            .encoded_pgm = 1,
+        },
+        .flags = MIB_STATIC_ENCODING | MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1234.2.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_7,
+            .value_type = BER_TYPE_GAUGE,
+            .encoded_ptr = encoded_7,
+            .encoded_len = 16,
+            .encoded_pgm = 1,
+        },
+        .flags = MIB_STATIC_ENCODING | MIB_PROGMEM_OID,
+    },
+    /* 1.3.6.1.2.1.1234.3.0 */
+    {
+        .varbind = {
+            .oid_ptr = (oid_t*)&oid_8,
+            .value_type = BER_TYPE_COUNTER64,
+            .value.u64_value = &value_8,
+            .encoded_ptr = encoded_8,
+            .encoded_len = 23,
+            .encoded_pgm = 1,
+        },
+        .flags = MIB_STATIC_ENCODING | MIB_PROGMEM_OID,
+    },
+};
+
+/* perfect hash of the scalars' OIDs, the index of the object plus one */
+static const u8t hash[] MIB_PROGMEM = {
+    5, 2, 1, 9, 7, 4, 3, 0, 8
+};
+
+const mib_static_t mib_generated MIB_PROGMEM = {
+    objects, 9,
+    hash, 9, 7
+};
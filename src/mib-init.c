@@ -1,15 +1,13 @@
 #include "mib-init.h"
+#include "stats.h"
 #include "ber.h"
 #include "utils.h"
 #include "logging.h"
 
-/* common oid prefixes ending with 0 */
-static const OID_T oid_system[]         = { 1, 3, 6, 1, 2, 1, 1, 0};
-static const OID_T oid_if[]     	= { 1, 3, 6, 1, 2, 1, 2, 0};
-static const OID_T oid_if_table[]	= { 1, 3, 6, 1, 2, 1, 2, 2, 1, 0};
-static const OID_T oid_test[]           = { 1, 3, 6, 1, 2, 1, 1234, 0};
+/* objects of the MIB described in mib.def */
+extern const mib_static_t mib_generated;
 
-s8t getSysDescr(mib_object_t* object, oid_item_t* oid_item, u8t len)
+s8t getSysDescr(mib_object_t* object, OID_T* oid, u8t len)
 {
     if (!object->varbind.value.s_value.len) {
         object->varbind.value.s_value.ptr = (u8t*)"System Description";
@@ -18,14 +16,20 @@ s8t getSysDescr(mib_object_t* object, oid_item_t* oid_item, u8t len)
     return 0;
 }
 
-s8t setSysDescr(mib_object_t* object, oid_item_t* oid_item, u8t len, varbind_value_t value)
+s8t setSysDescr(mib_object_t* object, OID_T* oid, u8t len, u8t phase, u8t value_type, varbind_value_t value)
 {
-    object->varbind.value.s_value.ptr = (u8t*)"System Description2";
-    object->varbind.value.s_value.len = 19;
+    static varbind_value_t previous;
+    if (phase == MIB_SET_COMMIT) {
+        previous = object->varbind.value;
+        object->varbind.value.s_value.ptr = (u8t*)"System Description2";
+        object->varbind.value.s_value.len = 19;
+    } else if (phase == MIB_SET_UNDO) {
+        object->varbind.value = previous;
+    }
     return 0;
 }
 
-s8t getTimeTicks(mib_object_t* object, oid_item_t* oid_item, u8t len)
+s8t getTimeTicks(mib_object_t* object, OID_T* oid, u8t len)
 {
     object->varbind.value.u_value = 1234;
     return 0;
@@ -35,7 +39,7 @@ s8t getTimeTicks(mib_object_t* object, oid_item_t* oid_item, u8t len)
 
 #define ifNumber 3
 
-s8t getIfNumber(mib_object_t* object, oid_item_t* oid_item, u8t len)
+s8t getIfNumber(mib_object_t* object, OID_T* oid, u8t len)
 {
     object->varbind.value.i_value = ifNumber;
     return 0;
@@ -43,16 +47,16 @@ s8t getIfNumber(mib_object_t* object, oid_item_t* oid_item, u8t len)
 
 #define ifIndex 1
 
-s8t getIf(mib_object_t* object, oid_item_t* oid_item, u8t len)
+s8t getIf(mib_object_t* object, OID_T* oid, u8t len)
 {
     if (len != 2) {
         return -1;
     }
-    switch (oid_item->value) {
+    switch (oid[0]) {
         case ifIndex:
             object->varbind.value_type = BER_TYPE_INTEGER;
-            if (0 < oid_item->next_ptr->value && oid_item->next_ptr->value <= ifNumber) {
-                object->varbind.value.i_value = oid_item->next_ptr->value;
+            if (0 < oid[1] && oid[1] <= ifNumber) {
+                object->varbind.value.i_value = oid[1];
             } else {
                 return -1;
             }
@@ -63,56 +67,44 @@ s8t getIf(mib_object_t* object, oid_item_t* oid_item, u8t len)
     return 0;
 }
 
-oid_item_t* getNextIfOid(mib_object_t* object, oid_item_t* oid_item, u8t len)
+s8t getNextIfOid(mib_object_t* object, OID_T* oid, u8t* len, u8t max_len)
 {
-    OID_T oid_el1 = (len > 0 ? oid_item->value : 0);
-    OID_T oid_el2 = (len > 1 ? oid_item->next_ptr->value : 0);
+    OID_T oid_el1 = (*len > 0 ? oid[0] : 0);
+    OID_T oid_el2 = (*len > 1 ? oid[1] : 0);
 
-    oid_item_t* ret, *ptr;
+    if (max_len < 2) {
+        return -1;
+    }
     if (oid_el1 < ifIndex) {
-        ret = oid_item_list_append(0, ifIndex);
-        CHECK_PTR_U(ret);
-        ptr = oid_item_list_append(ret, 1);
-        CHECK_PTR_U(ptr);
-        return ret;
+        oid[0] = ifIndex;
+        oid[1] = 1;
+        *len = 2;
+        return 0;
     }
 
     if (oid_el1 == ifIndex && oid_el2 < ifNumber) {
-        ret = oid_item_list_append(0, ifIndex);
-        CHECK_PTR_U(ret);
-        ptr = oid_item_list_append(ret, oid_el2 + 1);
-        CHECK_PTR_U(ptr);
-        return ret;
+        oid[1] = oid_el2 + 1;
+        *len = 2;
+        return 0;
     }
-    return 0;
+    return -1;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
  * Initialize the MIB.
+ * The objects are generated from mib.def by tools/mibgen.py, further ones can be added
+ * with add_scalar and add_table.
  */
 s8t mib_init()
 {
-    const u32t tconst = 12345678;
-    if (add_scalar(oid_system, 1, BER_TYPE_OCTET_STRING, 0, &getSysDescr, &setSysDescr) == -1 ||
-        add_scalar(oid_system, 3, BER_TYPE_TIME_TICKS, 0, &getTimeTicks, 0) == -1  ||
-        add_scalar(oid_system, 11, BER_TYPE_OCTET_STRING, "Pointer to a string", 0, 0) == -1 ||
-        add_scalar(oid_system, 13, BER_TYPE_TIME_TICKS, &tconst, 0, 0) == -1) {
+    if (mib_add_static(&mib_generated) == -1) {
         return -1;
     }
-
-    if (add_scalar(oid_if, 1, BER_TYPE_INTEGER, 0, &getIfNumber, 0) == -1) {
+#if ENABLE_AGENT_STATS
+    if (stats_mib_init() == -1) {
         return -1;
     }
-
-    if (add_table(oid_if_table, &getIf, &getNextIfOid, 0) == -1) {
-        return -1;
-    }
-
-    if (add_scalar(oid_test, 1, BER_TYPE_INTEGER, 0, 0, 0) == -1 ||
-       add_scalar(oid_test, 2, BER_TYPE_GAUGE, 0, 0, 0) == -1) {
-        return -1;
-    }
-
+#endif /* ENABLE_AGENT_STATS */
     return 0;
-}
\ No newline at end of file
+}
@@ -27,65 +27,131 @@
 #include "utils.h"
 #include "logging.h"
 
-static mib_object_t *mib_head = 0, *mib_tail = 0;
+#define TRACE_FILE 3
+
+/* MIB objects sorted by their OIDs in the lexicographical order */
+static mib_object_t* mib[MIB_LEN];
+static u16t mib_len = 0;
+
+/** \brief Position in the MIB of the last OID returned to a manager by GETNEXT. */
+typedef struct {
+    oid_t   oid;
+    s16t    index;
+} mib_cursor_t;
+
+/* perfect hash of the scalars of the generated MIB, in the program memory */
+static const u8t* mib_hash_table = 0;
+static mib_object_t* mib_hash_objects = 0;
+static u16t mib_hash_len = 0;
+static u16t mib_hash_seed = 0;
+
+/* walk cursors, the slot of a manager is chosen by its key */
+static mib_cursor_t mib_cursors[MIB_CURSOR_LEN];
+static mib_cursor_t* mib_cursor = &mib_cursors[0];
 
 /*-----------------------------------------------------------------------------------*/
 /*
  * Create an OID based on the prefix.
+ * MIB objects live longer than a request, so the OID is not allocated from the request arena.
  */
-static oid_t* create_oid_by_prefix(const OID_T* const prefix, oid_item_t** last_ptr)
+static oid_t* create_oid_by_prefix(const OID_T* const prefix)
 {
-    oid_t* oid = oid_create();
+    oid_t* oid = malloc(sizeof(oid_t));
     CHECK_PTR_U(oid);
-    
+    oid->len = 0;
+
     const OID_T* cur = prefix;
-    oid_item_t* oid_item_ptr = 0;
     while (*cur) {
-        if (!oid->first_ptr) {
-            oid_item_ptr = oid->first_ptr = oid_item_list_append(0, *cur);
-        } else {
-            oid_item_ptr = oid_item_list_append(oid_item_ptr, *cur);
-        }
-        if (!oid_item_ptr) {
+        if (oid->len == OID_LEN) {
+            snmp_log("oid prefix is longer than %d elements\n", OID_LEN);
+            free(oid);
             return 0;
         }
+        oid->values[oid->len++] = *cur;
         cur = cur + 1;
-        oid->len++;
-    }
-    if (last_ptr) {
-        *last_ptr = oid_item_ptr;
     }
     return oid;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Find the element number N in the list.
+ * Get the OID of the object, the OID of a generated object is copied from the program memory to the buffer.
  */
-static oid_item_t* element_n(oid_item_t* first_ptr, u8t n)
+static const oid_t* mib_oid(const mib_object_t* const object, oid_t* buf)
 {
-    while (n > 0 && first_ptr) {
-        first_ptr = first_ptr->next_ptr;
-        n--;
+    if (object->flags & MIB_PROGMEM_OID) {
+        mib_memcpy_P(buf, object->varbind.oid_ptr, sizeof(oid_t));
+        return buf;
     }
-    return first_ptr;
+    return object->varbind.oid_ptr;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Adds an object to the MIB.
- * TODO: sort while adding an object 
+ * Find the index of the last object in the MIB whose OID is less than or equal to the given one.
+ * Returns -1 if the OID precedes all the objects.
  */
-void mib_add(mib_object_t* object) {
-    if (!mib_head) {
-        mib_head = object;
-        mib_tail = object;
-        object->next_ptr = 0;
-    } else {
-        mib_tail->next_ptr = object;
-        object->next_ptr = 0;
-        mib_tail = object;
+static s16t mib_floor(const oid_t* const oid)
+{
+    s16t low = 0, high = mib_len - 1, mid, ret = -1;
+    oid_t buf;
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (oid_cmp(mib_oid(mib[mid], &buf), oid) <= 0) {
+            ret = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return ret;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Select the walk cursor of the manager sending the current request.
+ */
+void mib_cursor_select(u16t manager)
+{
+    mib_cursor = &mib_cursors[manager % MIB_CURSOR_LEN];
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find the floor of the OID, resuming from the cursor if the OID is the one returned last time.
+ */
+static s16t mib_cursor_floor(const oid_t* const oid)
+{
+    if (mib_cursor->oid.len && !oid_cmp(&mib_cursor->oid, oid)) {
+        return mib_cursor->index;
     }
+    return mib_floor(oid);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Adds an object to the MIB keeping the objects sorted.
+ */
+static s8t mib_add(mib_object_t* object)
+{
+    oid_t buf, object_buf;
+    const oid_t* oid = mib_oid(object, &object_buf);
+    s16t i = mib_floor(oid);
+    if (mib_len == MIB_LEN) {
+        snmp_log("the MIB can not contain more than %d objects\n", MIB_LEN);
+        return -1;
+    }
+    if (i != -1 && !oid_cmp(mib_oid(mib[i], &buf), oid)) {
+        snmp_log("the MIB already contains an object with the same oid\n");
+        return -1;
+    }
+    i++;
+    memmove(&mib[i + 1], &mib[i], (mib_len - i) * sizeof(mib_object_t*));
+    mib[i] = object;
+    mib_len++;
+    /* the positions remembered by the cursors have moved */
+    memset(mib_cursors, 0, sizeof(mib_cursors));
+    return 0;
 }
 
 /*-----------------------------------------------------------------------------------*/
@@ -125,6 +191,15 @@ s8t add_scalar(const OID_T* const prefix, const OID_T object_id, u8t value_type,
                 object->varbind.value.u_value = *((u32t*)value);
                 break;
 
+            case BER_TYPE_COUNTER64:
+                object->varbind.value.u64_value = (u64t*)malloc(sizeof(u64t));
+                if (!object->varbind.value.u64_value) {
+                    snmp_log("can not allocate memory for a Counter64\n");
+                    return -1;
+                }
+                *object->varbind.value.u64_value = *((u64t*)value);
+                break;
+
             case BER_TYPE_OPAQUE:
             case BER_TYPE_OID:
                 // TODO: implement
@@ -135,22 +210,19 @@ s8t add_scalar(const OID_T* const prefix, const OID_T object_id, u8t value_type,
         }
     }
     /* construct OID */
-    oid_item_t *item_ptr1, *item_ptr2;
-    oid_t* oid_ptr = create_oid_by_prefix(prefix, &item_ptr1);
+    oid_t* oid_ptr = create_oid_by_prefix(prefix);
+    CHECK_PTR(oid_ptr);
+    const OID_T suffix[] = {object_id, 0};
+    if (oid_append(oid_ptr, suffix, 2) == -1) {
+        return -1;
+    }
 
-    item_ptr1 = oid_item_list_append(item_ptr1, object_id);
-    item_ptr2 = oid_item_list_append(item_ptr1, 0);
-    CHECK_PTR(oid_ptr && !item_ptr1 && !item_ptr2);
-    oid_ptr->len += 2;
-    
     object->varbind.oid_ptr = oid_ptr;
 
     /* set value type */
     object->varbind.value_type = value_type;
 
-    mib_add(object);
-
-    return 0;
+    return mib_add(object);
 }
 
 /*-----------------------------------------------------------------------------------*/
@@ -163,7 +235,7 @@ s8t add_table(const OID_T* const prefix, get_value_t  gfp, get_next_oid_t gnofp,
     CHECK_PTR(object);
 
     /* copy the oid prefix */
-    oid_t* oid_ptr = create_oid_by_prefix(prefix, 0);
+    oid_t* oid_ptr = create_oid_by_prefix(prefix);
     CHECK_PTR(oid_ptr);
     
     object->varbind.oid_ptr = oid_ptr;
@@ -178,93 +250,207 @@ s8t add_table(const OID_T* const prefix, get_value_t  gfp, get_next_oid_t gnofp,
     /* mark the entry in the MIB as a table */
     object->varbind.value_type = BER_TYPE_NULL;
 
-    mib_add(object);
-    return 0;
+    return mib_add(object);
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Find an object in the MIB corresponding to the oid in the snmp-get request.
+ * Pass the value of the object to the request.
+ * Scalars without a getter keep their variable binding BER encoded, so it is encoded
+ * once and copied to every response until the value changes.
  */
-mib_object_t* mib_get(varbind_t* req)
+static void mib_copy_value(mib_object_t* object, varbind_t* req)
 {
-    mib_object_t* ptr = mib_head;
-    while (ptr) {
-        // scalar
-        if (ptr->varbind.oid_ptr->len == req->oid_ptr->len &&
-                !oid_cmp(ptr->varbind.oid_ptr, req->oid_ptr)) {
-            break;
-        } else if (ptr->get_next_oid_fnc_ptr && ptr->varbind.oid_ptr->len < req->oid_ptr->len &&
-                !oid_cmp(ptr->varbind.oid_ptr, req->oid_ptr)) {
-            // tabular
-            break;
+    u16t len = 0;
+    u8t* encoded_ptr;
+    varbind_t varbind;
+    oid_t buf;
+    if (!object->get_fnc_ptr && !object->get_next_oid_fnc_ptr && !object->varbind.encoded_ptr) {
+        /* the OID of a generated object is encoded from RAM */
+        varbind = object->varbind;
+        varbind.oid_ptr = (oid_t*)mib_oid(object, &buf);
+        object->varbind.encoded_len = ber_var_bind_size(&varbind);
+        if ((encoded_ptr = malloc(object->varbind.encoded_len)) != 0) {
+            if (ber_encode_var_bind(encoded_ptr, &len, object->varbind.encoded_len, &varbind) == 0 &&
+                    len == object->varbind.encoded_len) {
+                object->varbind.encoded_ptr = encoded_ptr;
+            } else {
+                free(encoded_ptr);
+            }
         }
-        ptr = ptr->next_ptr;
     }
+    memcpy(&req->value, &object->varbind.value, sizeof(varbind_value_t));
+    req->value_type = object->varbind.value_type;
+    req->encoded_ptr = object->varbind.encoded_ptr;
+    req->encoded_len = object->varbind.encoded_len;
+    req->encoded_pgm = object->varbind.encoded_pgm;
+}
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Drop the encoded variable binding of the object after its value has changed.
+ */
+void mib_object_changed(mib_object_t* object)
+{
+    if (object->varbind.encoded_ptr && !(object->flags & MIB_STATIC_ENCODING)) {
+        free((u8t*)object->varbind.encoded_ptr);
+    }
+    object->varbind.encoded_ptr = 0;
+    object->varbind.encoded_pgm = 0;
+    object->flags &= ~MIB_STATIC_ENCODING;
+}
 
-    if (!ptr) {
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Adds the objects of a generated MIB, whose descriptor is in the program memory.
+ * The objects are already sorted, so each of them is appended to the MIB.
+ */
+s8t mib_add_static(const mib_static_t* table)
+{
+    mib_static_t mib_static;
+    u16t i;
+    mib_memcpy_P(&mib_static, table, sizeof(mib_static_t));
+    for (i = 0; i < mib_static.len; i++) {
+        if (mib_add(&mib_static.objects[i]) == -1) {
+            return -1;
+        }
+    }
+    mib_hash_table = mib_static.hash;
+    mib_hash_objects = mib_static.objects;
+    mib_hash_len = mib_static.hash_len;
+    mib_hash_seed = mib_static.hash_seed;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Hash of an OID, tools/mibgen.py chooses the seed making it perfect for the generated scalars.
+ */
+u16t mib_hash(const oid_t* const oid, u16t seed)
+{
+    u8t i;
+    for (i = 0; i < oid->len; i++) {
+        seed = seed * 31 + oid->values[i];
+    }
+    return seed;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find a generated scalar with exactly the given oid.
+ */
+static mib_object_t* mib_hash_get(const oid_t* const oid)
+{
+    u8t i;
+    oid_t buf;
+    if (!mib_hash_len) {
+        return 0;
+    }
+    i = mib_read_byte_P(&mib_hash_table[mib_hash(oid, mib_hash_seed) % mib_hash_len]);
+    return i && !oid_cmp(mib_oid(&mib_hash_objects[i - 1], &buf), oid) ? &mib_hash_objects[i - 1] : 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find the object having the oid, either a scalar with the same oid or a table containing it.
+ */
+static mib_object_t* mib_find(const oid_t* const oid)
+{
+    s16t i;
+    oid_t buf;
+    const oid_t* object_oid;
+    mib_object_t* ptr = mib_hash_get(oid);
+    if (ptr) {
+        return ptr;
+    }
+    i = mib_floor(oid);
+    object_oid = i != -1 ? mib_oid(mib[i], &buf) : 0;
+    if (i == -1 || (oid_cmp(object_oid, oid) &&
+            !(mib[i]->get_next_oid_fnc_ptr && oid_starts_with(oid, object_oid)))) {
         snmp_log("mib object not found\n");
         return 0;
     }
+    return mib[i];
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find an object in the MIB corresponding to the oid in the snmp-get request.
+ */
+mib_object_t* mib_get(varbind_t* req)
+{
+    mib_object_t* ptr = mib_find(req->oid_ptr);
+    oid_t buf;
+    u8t prefix_len;
+    req->encoded_ptr = 0;
+
+    if (!ptr) {
+        return 0;
+    }
 
     if (ptr->get_fnc_ptr) {
-        if ((ptr->get_fnc_ptr)(ptr, element_n(req->oid_ptr->first_ptr, ptr->varbind.oid_ptr->len), req->oid_ptr->len - ptr->varbind.oid_ptr->len) == -1) {
+        prefix_len = mib_oid(ptr, &buf)->len;
+        if ((ptr->get_fnc_ptr)(ptr, &req->oid_ptr->values[prefix_len], req->oid_ptr->len - prefix_len) == -1) {
             snmp_log("can not get the value of the object\n");
             return 0;
         }
     }
 
-    /* copy the value */
-    memcpy(&req->value, &ptr->varbind.value, sizeof(varbind_value_t));
-    req->value_type = ptr->varbind.value_type;
+    mib_copy_value(ptr, req);
     return ptr;
 }
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the oid of the request to the next row of the table.
+ * If first is set, the first row of the table is requested.
+ */
+static s8t mib_get_next_row(mib_object_t* ptr, varbind_t* req, u8t first)
+{
+    /* the request keeps its oid if there is no next row */
+    OID_T index[OID_LEN];
+    oid_t buf;
+    const oid_t* prefix = mib_oid(ptr, &buf);
+    u8t prefix_len = prefix->len;
+    u8t len = 0;
+    if (!first && req->oid_ptr->len > prefix_len) {
+        len = req->oid_ptr->len - prefix_len;
+        memcpy(index, &req->oid_ptr->values[prefix_len], len * sizeof(OID_T));
+    }
+    if ((ptr->get_next_oid_fnc_ptr)(ptr, index, &len, OID_LEN - prefix_len) == -1 || len > OID_LEN - prefix_len) {
+        return -1;
+    }
+    /* copy the mib object's oid and attach the index */
+    oid_copy(req->oid_ptr, prefix);
+    return oid_append(req->oid_ptr, index, len);
+}
+
 /*-----------------------------------------------------------------------------------*/
 /*
  * Find an object in the MIB that is the lexicographical successor of the given one.
  */
 mib_object_t* mib_get_next(varbind_t* req)
 {
-    s8t cmp;
-    mib_object_t* ptr = mib_head;
-    while (ptr) {
-        // find the object
-        cmp = oid_cmp(req->oid_ptr, ptr->varbind.oid_ptr);
-
-        if (!ptr->get_next_oid_fnc_ptr) {
-            // handle scalar object
-            if (cmp == -1 || (cmp == 0 && req->oid_ptr->len < ptr->varbind.oid_ptr->len)) {
-                /* free the request oid list */
-                oid_free(req->oid_ptr);
-                req->oid_ptr = oid_copy(ptr->varbind.oid_ptr, 0);
-                CHECK_PTR_U(req->oid_ptr);
-                break;
-            }
-        } else {
-            /* handle tabular object */
-            if (cmp == -1 || cmp == 0) {
-                /* oid of the first element */
-                oid_item_t* tail_ptr;
-                if ((tail_ptr = (ptr->get_next_oid_fnc_ptr)(ptr, (cmp == -1 ? 0 : element_n(req->oid_ptr->first_ptr, ptr->varbind.oid_ptr->len)),
-                        cmp == -1 ? 0 : req->oid_ptr->len - ptr->varbind.oid_ptr->len)) != 0) {
-                    /* copy the mib object's oid */
-                    oid_item_t* last_ptr;
-                    oid_t* new_oid_ptr = oid_copy(ptr->varbind.oid_ptr, &last_ptr);
-                    CHECK_PTR_U(new_oid_ptr);
-                    /* attach the tail */
-                    last_ptr->next_ptr = tail_ptr;
-                    new_oid_ptr->len += oid_length(tail_ptr);
-                    /* free the previos oid */
-                    oid_free(req->oid_ptr);
-                    /* set the new one */
-                    req->oid_ptr = new_oid_ptr;
-                    break;                    
-                }
-            }
+    mib_object_t* ptr = 0;
+    oid_t buf;
+    u8t prefix_len;
+    s16t i = mib_cursor_floor(req->oid_ptr);
+    req->encoded_ptr = 0;
+
+    /* the requested oid points into a table: try the next row of the same table */
+    if (i != -1 && mib[i]->get_next_oid_fnc_ptr && oid_starts_with(req->oid_ptr, mib_oid(mib[i], &buf)) &&
+            mib_get_next_row(mib[i], req, 0) != -1) {
+        ptr = mib[i];
+    }
+
+    /* otherwise all the following objects are successors of the requested oid */
+    while (!ptr && ++i < mib_len) {
+        if (!mib[i]->get_next_oid_fnc_ptr) {
+            oid_copy(req->oid_ptr, mib_oid(mib[i], &buf));
+            ptr = mib[i];
+        } else if (mib_get_next_row(mib[i], req, 1) != -1) {
+            ptr = mib[i];
         }
-        ptr = ptr->next_ptr;
     }
 
     if (!ptr) {
@@ -272,30 +458,82 @@ mib_object_t* mib_get_next(varbind_t* req)
         return 0;
     }
 
+    /* the next request of the walk continues from here */
+    oid_copy(&mib_cursor->oid, req->oid_ptr);
+    mib_cursor->index = i;
+
     if (ptr->get_fnc_ptr) {
-        if ((ptr->get_fnc_ptr)(ptr, element_n(req->oid_ptr->first_ptr, ptr->varbind.oid_ptr->len),
-                                    req->oid_ptr->len - ptr->varbind.oid_ptr->len) == -1) {
+        prefix_len = mib_oid(ptr, &buf)->len;
+        if ((ptr->get_fnc_ptr)(ptr, &req->oid_ptr->values[prefix_len], req->oid_ptr->len - prefix_len) == -1) {
             snmp_log("can not get the value of the object\n");
             return 0;
         }
     }
 
-    /* copy the value */
-    memcpy(&req->value, &ptr->varbind.value, sizeof(varbind_value_t));
-    req->value_type = ptr->varbind.value_type;
+    mib_copy_value(ptr, req);
     return ptr;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Set the value for an object in the MIB.
+ * Call the set function of the object with the part of the requested oid following the object's oid.
+ */
+static s8t mib_set_call(mib_object_t* object, varbind_t* req, u8t phase)
+{
+    oid_t buf;
+    u8t prefix_len = mib_oid(object, &buf)->len;
+    return (object->set_fnc_ptr)(object, &req->oid_ptr->values[prefix_len],
+            req->oid_ptr->len - prefix_len, phase, req->value_type, req->value);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Find the object of a variable binding of a SET request and check the new value.
+ * Nothing is changed, the error status of the variable binding is returned.
+ */
+u8t mib_set_validate(mib_set_entry_t* entry, varbind_t* req)
+{
+    mib_object_t* object = mib_find(req->oid_ptr);
+    entry->req = req;
+    entry->object = object;
+    if (!object || (object->get_next_oid_fnc_ptr && !object->set_fnc_ptr)) {
+        return ERROR_STATUS_NO_SUCH_NAME;
+    }
+    /* the type of a scalar is known without getting its value, the set function of a table checks it */
+    if (!object->get_next_oid_fnc_ptr && object->varbind.value_type != req->value_type) {
+        snmp_log("bad value type %d %d\n", object->varbind.value_type, req->value_type);
+        return ERROR_STATUS_BAD_VALUE;
+    }
+    if (object->set_fnc_ptr) {
+        return mib_set_call(object, req, MIB_SET_VALIDATE) == -1 ? ERROR_STATUS_BAD_VALUE : ERROR_STATUS_NO_ERROR;
+    }
+    switch (req->value_type) {
+        case BER_TYPE_IPADDRESS:
+        case BER_TYPE_OCTET_STRING:
+        case BER_TYPE_INTEGER:
+        case BER_TYPE_COUNTER:
+        case BER_TYPE_TIME_TICKS:
+        case BER_TYPE_GAUGE:
+        case BER_TYPE_COUNTER64:
+            return ERROR_STATUS_NO_ERROR;
+        default:
+            /* OPAQUE and OID values can not be set yet */
+            return ERROR_STATUS_BAD_VALUE;
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the value of the validated object, the previous value is kept in the entry for the undo.
  */
-s8t mib_set(mib_object_t* object, varbind_t* req)
+s8t mib_set_commit(mib_set_entry_t* entry)
 {
+    mib_object_t* object = entry->object;
+    varbind_t* req = entry->req;
+    entry->value = object->varbind.value;
+    entry->flags = object->flags;
     if (object->set_fnc_ptr) {
-        if ((object->set_fnc_ptr)(object,
-                element_n(req->oid_ptr->first_ptr, object->varbind.oid_ptr->len),
-                req->oid_ptr->len - object->varbind.oid_ptr->len, req->value) == -1) {
+        if (mib_set_call(object, req, MIB_SET_COMMIT) == -1) {
             snmp_log("can not set the value of the object\n");
             return -1;
         }
@@ -303,15 +541,15 @@ s8t mib_set(mib_object_t* object, varbind_t* req)
         switch (req->value_type) {
             case BER_TYPE_IPADDRESS:
             case BER_TYPE_OCTET_STRING:
-                if (object->varbind.value.s_value.ptr) {
-                    free(object->varbind.value.s_value.ptr);
-                }
-                object->varbind.value.s_value.len = req->value.s_value.len;
+                /* the previous string is freed when the whole request succeeds */
                 object->varbind.value.s_value.ptr = (u8t*)malloc(req->value.s_value.len);
                 if (!object->varbind.value.s_value.ptr) {
                     snmp_log("can not allocate memory for a string\n");
+                    object->varbind.value = entry->value;
                     return -1;
                 }
+                object->flags &= ~MIB_STATIC_VALUE;
+                object->varbind.value.s_value.len = req->value.s_value.len;
                 memcpy(object->varbind.value.s_value.ptr, req->value.s_value.ptr, object->varbind.value.s_value.len);
                 break;
 
@@ -325,13 +563,75 @@ s8t mib_set(mib_object_t* object, varbind_t* req)
                 object->varbind.value.u_value = req->value.u_value;
                 break;
 
-            case BER_TYPE_OPAQUE:
-            case BER_TYPE_OID:
-                /* TODO: implement */
-                return -1;
+            case BER_TYPE_COUNTER64:
+                /* the value is kept in place unless it is static */
+                if (!object->varbind.value.u64_value || (object->flags & MIB_STATIC_VALUE)) {
+                    object->varbind.value.u64_value = (u64t*)malloc(sizeof(u64t));
+                    if (!object->varbind.value.u64_value) {
+                        snmp_log("can not allocate memory for a Counter64\n");
+                        object->varbind.value = entry->value;
+                        return -1;
+                    }
+                    object->flags &= ~MIB_STATIC_VALUE;
+                } else {
+                    entry->u64_value = *object->varbind.value.u64_value;
+                }
+                *object->varbind.value.u64_value = VARBIND_U64(req->value);
+                break;
+
             default:
                 return -1;
         }
     }
+    mib_object_changed(object);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Restore the value the object had before the commit.
+ */
+s8t mib_set_undo(mib_set_entry_t* entry)
+{
+    mib_object_t* object = entry->object;
+    varbind_t* req = entry->req;
+    if (object->set_fnc_ptr) {
+        if (mib_set_call(object, req, MIB_SET_UNDO) == -1) {
+            snmp_log("can not undo the value of the object\n");
+            return -1;
+        }
+    } else {
+        switch (req->value_type) {
+            case BER_TYPE_IPADDRESS:
+            case BER_TYPE_OCTET_STRING:
+                free(object->varbind.value.s_value.ptr);
+                break;
+
+            case BER_TYPE_COUNTER64:
+                if (object->varbind.value.u64_value != entry->value.u64_value) {
+                    free(object->varbind.value.u64_value);
+                } else {
+                    *object->varbind.value.u64_value = entry->u64_value;
+                }
+                break;
+        }
+        object->varbind.value = entry->value;
+        object->flags = (object->flags & ~MIB_STATIC_VALUE) | (entry->flags & MIB_STATIC_VALUE);
+    }
+    mib_object_changed(object);
     return 0;
-}
\ No newline at end of file
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Release the previous value of the object once the whole SET request has succeeded.
+ */
+void mib_set_finish(mib_set_entry_t* entry)
+{
+    varbind_t* req = entry->req;
+    /* a Counter64 value is written in place and a static value is not freed */
+    if (!entry->object->set_fnc_ptr && (req->value_type == BER_TYPE_OCTET_STRING || req->value_type == BER_TYPE_IPADDRESS) &&
+            entry->value.s_value.ptr && !(entry->flags & MIB_STATIC_VALUE)) {
+        free(entry->value.s_value.ptr);
+    }
+}
@@ -27,11 +27,54 @@
 typedef struct mib_object_t mib_object_t;
 
 /*
- *  Function types to treat tabular structures
+ * The constant data of the MIB generated by tools/mibgen.py (OIDs, encoded variable
+ * bindings and the hash) is kept in the program memory and read with these accessors.
  */
-typedef s8t (*get_value_t)(mib_object_t* object, oid_item_t* oid_item, u8t len);
-typedef oid_item_t* (*get_next_oid_t)(mib_object_t* object, oid_item_t* oid_item, u8t len);
-typedef s8t (*set_value_t)(mib_object_t* object, oid_item_t* oid_item, u8t len, varbind_value_t value);
+#if CONTIKI_TARGET_AVR_RAVEN
+#include <avr/pgmspace.h>
+#define MIB_PROGMEM                         PROGMEM
+#define mib_memcpy_P(dst, src, len)         memcpy_P(dst, src, len)
+#define mib_read_byte_P(ptr)                pgm_read_byte(ptr)
+#else
+#define MIB_PROGMEM
+#define mib_memcpy_P(dst, src, len)         memcpy(dst, src, len)
+#define mib_read_byte_P(ptr)                (*(const u8t*)(ptr))
+#endif /* CONTIKI_TARGET_AVR_RAVEN */
+
+/* The string or Counter64 value of the object is not allocated on the heap and is not written. */
+#define MIB_STATIC_VALUE        0x01
+/* The encoded variable binding of the object is not allocated on the heap. */
+#define MIB_STATIC_ENCODING     0x02
+/* The OID of the object is in the program memory. */
+#define MIB_PROGMEM_OID         0x04
+
+/*
+ *  Function types to treat tabular structures.
+ *  The oid argument is the part of the requested OID following the object's
+ *  OID (the row index for tables) and len is the number of its elements.
+ *  get_next_oid_t replaces the index in the oid buffer with the index of the
+ *  next row and stores its length in len; the buffer holds up to max_len
+ *  elements and len is 0 when the first row is requested. It returns -1 if
+ *  there is no next row.
+ *  String values passed to set_value_t point into the request and have to be
+ *  copied to be kept.
+ *
+ *  A SET request is applied in phases. set_value_t is called with MIB_SET_VALIDATE
+ *  for all the variable bindings before anything is changed; it checks the value
+ *  (and its type for a table) and has no side effects. Then it is called with
+ *  MIB_SET_COMMIT for each of them, and if one of the commits fails, with
+ *  MIB_SET_UNDO for the committed ones in the reverse order, so the function has
+ *  to keep the value it replaces on commit. Objects without a set function are
+ *  handled by the MIB itself, tables without one are not writable.
+ */
+typedef s8t (*get_value_t)(mib_object_t* object, OID_T* oid, u8t len);
+typedef s8t (*get_next_oid_t)(mib_object_t* object, OID_T* oid, u8t* len, u8t max_len);
+typedef s8t (*set_value_t)(mib_object_t* object, OID_T* oid, u8t len, u8t phase, u8t value_type, varbind_value_t value);
+
+/* Phases of a SET request passed to set_value_t. */
+#define MIB_SET_VALIDATE        0
+#define MIB_SET_COMMIT          1
+#define MIB_SET_UNDO            2
 
 typedef struct mib_object_t
 {
@@ -50,18 +93,60 @@ typedef struct mib_object_t
      */
     set_value_t set_fnc_ptr;
 
-    struct mib_object_t* next_ptr;
+    /* MIB_STATIC_* flags.
+     */
+    u8t flags;
 
 } mib_object_type;
 
+/** \brief MIB generated by tools/mibgen.py with the objects sorted by their OIDs.
+ * The descriptor and the hash are in the program memory, the objects hold the values
+ * and the cached encodings, which change at run time, and stay in RAM. */
+typedef struct {
+    mib_object_t*           objects;
+    u16t                    len;
+    /* perfect hash of the scalars' OIDs, see mib_hash(), the index of an object plus one or 0 */
+    const u8t*              hash;
+    u16t                    hash_len;
+    u16t                    hash_seed;
+} mib_static_t;
+
+/** \brief Variable binding of a SET request, its object and the value the object had before the commit. */
+typedef struct {
+    varbind_t*              req;
+    mib_object_t*           object;
+    varbind_value_t         value;
+    /* the previous Counter64 value, which is written in place */
+    u64t                    u64_value;
+    u8t                     flags;
+} mib_set_entry_t;
+
 s8t add_scalar(const OID_T* const prefix, const OID_T object_id, u8t value_type, const void* const value, get_value_t gfp, set_value_t svfp);
 
 s8t add_table(const OID_T* const prefix, get_value_t  gfp, get_next_oid_t gnofp, set_value_t svfp);
 
+s8t mib_add_static(const mib_static_t* table);
+
+u16t mib_hash(const oid_t* const oid, u16t seed);
+
 mib_object_t* mib_get(varbind_t* req);
 
 mib_object_t* mib_get_next(varbind_t* req);
 
-s8t mib_set(mib_object_t* object, varbind_t* req);
+/* Selects the GETNEXT walk cursor of the manager, e.g. a hash of its address and port. */
+void mib_cursor_select(u16t manager);
+
+/* Finds the object of the variable binding and checks the value, returns the error status. */
+u8t mib_set_validate(mib_set_entry_t* entry, varbind_t* req);
+
+s8t mib_set_commit(mib_set_entry_t* entry);
+
+s8t mib_set_undo(mib_set_entry_t* entry);
+
+/* Releases the replaced value after all the variable bindings have been committed. */
+void mib_set_finish(mib_set_entry_t* entry);
+
+/* Has to be called when the value of a scalar without a getter is changed outside of a SET request. */
+void mib_object_changed(mib_object_t* object);
 
 #endif /* __MIB_H__ */
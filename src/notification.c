@@ -0,0 +1,302 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Originator of SNMPv2-Trap and Inform notifications
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#include "notification.h"
+#include "ber.h"
+#include "mib.h"
+#include "utils.h"
+#include "logging.h"
+
+#define TRACE_FILE 4
+
+/* sysUpTime.0 and snmpTrapOID.0 open every notification PDU */
+static const oid_t sys_up_time_oid = {{1, 3, 6, 1, 2, 1, 1, 3, 0}, 9};
+static const oid_t snmp_trap_oid = {{1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0}, 11};
+
+/* the pending trap PDU and the trap OID of its notifications, there is no pending PDU if its length is 0 */
+static u8t buffer[NOTIFICATION_BUF_SIZE];
+static ber_stream_t stream;
+static oid_t pending_oid;
+
+/** \brief Inform waiting for an acknowledgement. */
+typedef struct {
+    s32t    request_id;
+    /* the time of the next retransmission and the current timeout in clock ticks */
+    u16t    deadline;
+    u16t    timeout;
+    u8t     retries;
+    /* the encoded Inform starts at data + start, the slot is free if its length is 0 */
+    u16t    start;
+    u16t    len;
+    u8t     data[INFORM_MAX_LEN];
+} inform_t;
+
+/* one slot more than the queue holds, so a new Inform is encoded before an old one is dropped */
+#define INFORM_SLOTS (INFORM_QUEUE_LEN + 1)
+
+static inform_t informs[INFORM_SLOTS];
+
+static s32t request_id = 0;
+static notification_send_t send_fnc_ptr = 0;
+
+/* the manager the notifications are sent to and the sender of the datagram being handled */
+static u16t manager_addr, manager_port;
+static u16t sender_addr, sender_port;
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the function sending the notifications and the manager receiving them.
+ */
+void notification_init(notification_send_t send, const u16t addr, const u16t port)
+{
+    send_fnc_ptr = send;
+    manager_addr = addr;
+    manager_port = port;
+    pending_oid.len = 0;
+    memset(informs, 0, sizeof(informs));
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Start a new PDU with the sysUpTime.0 and snmpTrapOID.0 variable bindings.
+ */
+static s8t notification_start(ber_stream_t* stream, const u8t pdu_type, u8t* output, const u16t max_len, const oid_t* const trap_oid)
+{
+    message_t message;
+    varbind_t varbind;
+
+    memset(&message, 0, sizeof(message_t));
+    message.version = SNMP_VERSION_2C;
+    message.community = (u8t*)NOTIFICATION_COMMUNITY;
+    message.community_len = sizeof(NOTIFICATION_COMMUNITY) - 1;
+    message.pdu.request_id = ++request_id;
+    if (ber_stream_start(stream, &message, pdu_type, output, max_len) == -1) {
+        return -1;
+    }
+
+    /* the uptime is taken from the MIB */
+    memset(&varbind, 0, sizeof(varbind_t));
+    varbind.oid_ptr = (oid_t*)&sys_up_time_oid;
+    if (!mib_get(&varbind)) {
+        varbind.value_type = BER_TYPE_TIME_TICKS;
+        varbind.value.u_value = 0;
+    }
+    if (ber_stream_append(stream, &varbind) == -1) {
+        return -1;
+    }
+
+    memset(&varbind, 0, sizeof(varbind_t));
+    varbind.oid_ptr = (oid_t*)&snmp_trap_oid;
+    varbind.value_type = BER_TYPE_OID;
+    varbind.value.oid_value = trap_oid;
+    return ber_stream_append(stream, &varbind);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append the variable bindings of a notification to a PDU.
+ * Returns -1 and leaves the PDU untouched if they do not fit.
+ */
+static s8t notification_append(ber_stream_t* stream, const varbind_t* varbinds)
+{
+    u16t len = stream->len;
+    const varbind_t* ptr;
+    for (ptr = varbinds; ptr; ptr = ptr->next_ptr) {
+        if (ber_stream_append(stream, ptr) == -1) {
+            stream->len = len;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Add a notification to the pending PDU.
+ */
+s8t notification_raise(const oid_t* const trap_oid, const varbind_t* varbinds)
+{
+    /* notifications of another kind are not merged */
+    if (pending_oid.len && oid_cmp(&pending_oid, trap_oid)) {
+        notification_flush();
+    }
+
+    if (pending_oid.len) {
+        if (notification_append(&stream, varbinds) != -1) {
+            return 0;
+        }
+        /* the pending PDU is full */
+        notification_flush();
+    }
+
+    if (notification_start(&stream, BER_TYPE_SNMP_TRAP, buffer, NOTIFICATION_BUF_SIZE, trap_oid) == -1) {
+        snmp_log("the notification does not fit into %d bytes\n", NOTIFICATION_BUF_SIZE);
+        return -1;
+    }
+    stream.max_len = NOTIFICATION_MAX_LEN;
+    if (notification_append(&stream, varbinds) == -1) {
+        /* a notification longer than a frame is sent on its own */
+        stream.max_len = NOTIFICATION_BUF_SIZE;
+        if (notification_append(&stream, varbinds) == -1) {
+            snmp_log("the notification does not fit into %d bytes\n", NOTIFICATION_BUF_SIZE);
+            return -1;
+        }
+        stream.max_len = 0;
+    }
+    oid_copy(&pending_oid, trap_oid);
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Send the pending PDU.
+ */
+void notification_flush()
+{
+    if (!pending_oid.len) {
+        return;
+    }
+    ber_stream_finish(&stream);
+    if (send_fnc_ptr) {
+        (send_fnc_ptr)(buffer + stream.start, stream.len);
+    }
+    pending_oid.len = 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Send an Inform and keep it until it is acknowledged.
+ * If the queue is full, the oldest Inform is dropped once the new one is encoded.
+ */
+s8t inform_raise(const oid_t* const trap_oid, const varbind_t* varbinds, const u16t now, const u16t timeout)
+{
+    ber_stream_t inform_stream;
+    inform_t* ptr = 0;
+    inform_t* oldest = 0;
+    u8t i, len = 0;
+    for (i = 0; i < INFORM_SLOTS; i++) {
+        if (!informs[i].len) {
+            ptr = &informs[i];
+        } else {
+            if (!oldest || informs[i].request_id < oldest->request_id) {
+                oldest = &informs[i];
+            }
+            len++;
+        }
+    }
+
+    /* the queue keeps a free slot */
+    if (notification_start(&inform_stream, BER_TYPE_SNMP_INFORM, ptr->data, INFORM_MAX_LEN, trap_oid) == -1 ||
+            notification_append(&inform_stream, varbinds) == -1) {
+        snmp_log("the inform does not fit into %d bytes\n", INFORM_MAX_LEN);
+        return -1;
+    }
+    ber_stream_finish(&inform_stream);
+
+    if (len == INFORM_QUEUE_LEN) {
+        snmp_log("inform %d dropped\n", oldest->request_id);
+        oldest->len = 0;
+    }
+
+    ptr->request_id = request_id;
+    ptr->timeout = timeout;
+    ptr->deadline = now + ptr->timeout;
+    ptr->retries = INFORM_RETRIES;
+    ptr->start = inform_stream.start;
+    ptr->len = inform_stream.len;
+    if (send_fnc_ptr) {
+        (send_fnc_ptr)(ptr->data + ptr->start, ptr->len);
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Select the sender of the datagram being handled.
+ */
+void inform_sender_select(const u16t addr, const u16t port)
+{
+    sender_addr = addr;
+    sender_port = port;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Remove the acknowledged Inform from the queue.
+ */
+s8t inform_acknowledge(const s32t request_id)
+{
+    u8t i;
+    /* only the manager the Informs are sent to acknowledges them */
+    if (!send_fnc_ptr || sender_addr != manager_addr || sender_port != manager_port) {
+        return -1;
+    }
+    for (i = 0; i < INFORM_SLOTS; i++) {
+        if (informs[i].len && informs[i].request_id == request_id) {
+            informs[i].len = 0;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Retransmit the Informs whose timeouts have expired, doubling the timeouts,
+ * and drop the ones without retries left.
+ */
+u8t inform_poll(const u16t now, u16t* next)
+{
+    u8t i, pending = 0;
+    for (i = 0; i < INFORM_SLOTS; i++) {
+        if (!informs[i].len) {
+            continue;
+        }
+        /* the clock wraps around */
+        if ((s16t)(now - informs[i].deadline) >= 0) {
+            if (!informs[i].retries) {
+                snmp_log("inform %d is not acknowledged\n", informs[i].request_id);
+                informs[i].len = 0;
+                continue;
+            }
+            informs[i].retries--;
+            informs[i].timeout *= 2;
+            informs[i].deadline = now + informs[i].timeout;
+            if (send_fnc_ptr) {
+                (send_fnc_ptr)(informs[i].data + informs[i].start, informs[i].len);
+            }
+        }
+        if (!pending || (s16t)(informs[i].deadline - *next) < 0) {
+            *next = informs[i].deadline;
+        }
+        pending = 1;
+    }
+    return pending;
+}
@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Originator of SNMPv2-Trap and Inform notifications
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __NOTIFICATION_H__
+#define	__NOTIFICATION_H__
+
+#include "snmp.h"
+
+/** \brief Function sending an encoded notification to the manager. */
+typedef void (*notification_send_t)(const u8t* data, u16t len);
+
+/*
+ * Sets the function sending the notifications and the manager they are sent to, given as
+ * the last 16 bits of its address and its port as they are stored in them.
+ */
+void notification_init(notification_send_t send, const u16t manager_addr, const u16t manager_port);
+
+/*
+ * Adds a notification with the given variable bindings to the pending PDU.
+ * Notifications with the same trap OID raised before the pending PDU is flushed
+ * are merged into a single SNMPv2-Trap PDU of at most NOTIFICATION_MAX_LEN bytes,
+ * a longer notification is sent on its own.
+ * Returns 1 if a new PDU was started, so the coalescing window has to be opened,
+ * 0 if the notification was merged and -1 if it can not be sent.
+ */
+s8t notification_raise(const oid_t* const trap_oid, const varbind_t* varbinds);
+
+/* Sends the pending PDU if there is one. */
+void notification_flush();
+
+/*
+ * Sends an Inform and queues it until it is acknowledged. Informs are not
+ * coalesced. The queue holds INFORM_QUEUE_LEN Informs, the oldest one is
+ * dropped when the queue is full and the new one has been encoded. The time
+ * and the timeout before the first retransmission are given in clock ticks.
+ */
+s8t inform_raise(const oid_t* const trap_oid, const varbind_t* varbinds, const u16t now, const u16t timeout);
+
+/* Selects the sender of the datagram being handled, given like the manager of notification_init. */
+void inform_sender_select(const u16t addr, const u16t port);
+
+/*
+ * Removes the Inform with the request id from the queue if the datagram being handled comes
+ * from the manager the Informs are sent to, returns -1 if there is none.
+ */
+s8t inform_acknowledge(const s32t request_id);
+
+/*
+ * Retransmits the Informs which are due. Returns 1 and the time of the next
+ * retransmission if there are Informs waiting for an acknowledgement.
+ */
+u8t inform_poll(const u16t now, u16t* next);
+
+#endif	/* __NOTIFICATION_H__ */
@@ -0,0 +1,156 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         SHA-1 message digest (FIPS 180-2)
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#include "sha1.h"
+
+/* u32t may be wider than 32 bits, so the words are truncated after every operation that can overflow */
+#define WORD(x)         ((x) & 0xFFFFFFFFUL)
+#define ROTL(x, n)      WORD(((x) << (n)) | ((x) >> (32 - (n))))
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Process a 64 bytes long block of the message.
+ * The message schedule is kept in a 16 words long circular buffer.
+ */
+static void sha1_transform(sha1_ctx_t* ctx)
+{
+    u32t w[16];
+    u32t a, b, c, d, e, f, k, tmp;
+    u8t i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((u32t)ctx->block[4 * i] << 24) | ((u32t)ctx->block[4 * i + 1] << 16) |
+                ((u32t)ctx->block[4 * i + 2] << 8) | ctx->block[4 * i + 3];
+    }
+
+    a = ctx->state[0];
+    b = ctx->state[1];
+    c = ctx->state[2];
+    d = ctx->state[3];
+    e = ctx->state[4];
+
+    for (i = 0; i < 80; i++) {
+        if (i >= 16) {
+            w[i & 15] = ROTL(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999UL;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1UL;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDCUL;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6UL;
+        }
+        tmp = WORD(ROTL(a, 5) + WORD(f) + e + k + w[i & 15]);
+        e = d;
+        d = c;
+        c = ROTL(b, 30);
+        b = a;
+        a = tmp;
+    }
+
+    ctx->state[0] = WORD(ctx->state[0] + a);
+    ctx->state[1] = WORD(ctx->state[1] + b);
+    ctx->state[2] = WORD(ctx->state[2] + c);
+    ctx->state[3] = WORD(ctx->state[3] + d);
+    ctx->state[4] = WORD(ctx->state[4] + e);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Start computing a digest.
+ */
+void sha1_init(sha1_ctx_t* ctx)
+{
+    ctx->state[0] = 0x67452301UL;
+    ctx->state[1] = 0xEFCDAB89UL;
+    ctx->state[2] = 0x98BADCFEUL;
+    ctx->state[3] = 0x10325476UL;
+    ctx->state[4] = 0xC3D2E1F0UL;
+    ctx->count = 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Add the data to the digest.
+ */
+void sha1_update(sha1_ctx_t* ctx, const u8t* data, u16t len)
+{
+    u8t used, n;
+    while (len > 0) {
+        used = ctx->count & (SHA1_BLOCK_LEN - 1);
+        n = SHA1_BLOCK_LEN - used;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->block + used, data, n);
+        ctx->count += n;
+        data += n;
+        len -= n;
+        if ((ctx->count & (SHA1_BLOCK_LEN - 1)) == 0) {
+            sha1_transform(ctx);
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Pad the message and write the digest.
+ */
+void sha1_final(sha1_ctx_t* ctx, u8t* digest)
+{
+    /* the length of the message in bits */
+    u32t bits = WORD(ctx->count << 3);
+    u8t used = ctx->count & (SHA1_BLOCK_LEN - 1);
+    u8t i;
+
+    ctx->block[used++] = 0x80;
+    if (used > SHA1_BLOCK_LEN - 8) {
+        memset(ctx->block + used, 0, SHA1_BLOCK_LEN - used);
+        sha1_transform(ctx);
+        used = 0;
+    }
+    memset(ctx->block + used, 0, SHA1_BLOCK_LEN - used);
+    /* messages shorter than 512 MB, the upper word of the length is 0 */
+    ctx->block[SHA1_BLOCK_LEN - 5] = (ctx->count >> 29) & 0xFF;
+    for (i = 0; i < 4; i++) {
+        ctx->block[SHA1_BLOCK_LEN - 1 - i] = (bits >> (8 * i)) & 0xFF;
+    }
+    sha1_transform(ctx);
+
+    for (i = 0; i < SHA1_DIGEST_LEN; i++) {
+        digest[i] = (ctx->state[i >> 2] >> (8 * (3 - (i & 3)))) & 0xFF;
+    }
+}
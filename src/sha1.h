@@ -0,0 +1,50 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         SHA-1 message digest (FIPS 180-2)
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __SHA1_H__
+#define	__SHA1_H__
+
+#include "snmpd-types.h"
+
+#define SHA1_DIGEST_LEN     20
+#define SHA1_BLOCK_LEN      64
+
+/** \brief State of a digest computed incrementally. */
+typedef struct {
+    u32t    state[5];
+    u32t    count;
+    u8t     block[SHA1_BLOCK_LEN];
+} sha1_ctx_t;
+
+void sha1_init(sha1_ctx_t* ctx);
+
+void sha1_update(sha1_ctx_t* ctx, const u8t* data, u16t len);
+
+void sha1_final(sha1_ctx_t* ctx, u8t* digest);
+
+#endif	/* __SHA1_H__ */
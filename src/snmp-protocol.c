@@ -25,172 +25,410 @@
 #include "snmp-protocol.h"
 #include "ber.h"
 #include "mib.h"
+#include "notification.h"
+#include "usm.h"
+#include "compact.h"
+#include "stats.h"
 #include "logging.h"
 #include "utils.h"
 
+#define TRACE_FILE 5
+
+/** \brief Encoding of the messages, a request is answered in the encoding it comes in. */
+typedef struct {
+    s8t (*decode_header)(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+    s8t (*decode_var_bind)(const u8t* const input, const u16t len, u16t* pos, varbind_t* varbind);
+    s8t (*decode_var_binds)(const u8t* const input, const u16t len, u16t* pos, message_t* request);
+    s8t (*encode_response)(message_t* message, u8t* output, u16t* output_len, const u8t* const input, u16t input_len, const u16t max_output_len);
+    s8t (*stream_start)(ber_stream_t* stream, message_t* message, const u8t pdu_type, u8t* output, const u16t max_output_len);
+    s8t (*stream_append)(ber_stream_t* stream, const varbind_t* const varbind);
+    void (*stream_finish)(ber_stream_t* stream);
+} codec_t;
+
+static const codec_t ber_codec = {
+    &ber_decode_header, &ber_decode_var_bind, &ber_decode_var_binds, &ber_encode_response, &ber_stream_start, &ber_stream_append, &ber_stream_finish
+};
+
+#if ENABLE_COMPACT_CODEC
+static const codec_t compact_codec = {
+    &compact_decode_header, &compact_decode_var_bind, &compact_decode_var_binds, &compact_encode_response, &compact_stream_start, &compact_stream_append, &compact_stream_finish
+};
+#endif /* ENABLE_COMPACT_CODEC */
+
+/** \brief Variable bindings of a GET or GETNEXT request.
+ * They are decoded from the input one by one into the same variable binding, unless the input is not
+ * set and the request has been decoded as a whole, e.g. after the security model decrypted it. */
+typedef struct {
+    const codec_t*  codec;
+    const u8t*      input;
+    u16t            len;
+    u16t            pos;
+    /* the arena is released to this mark before decoding the next variable binding */
+    u16t            mark;
+    varbind_t*      next_ptr;
+    varbind_t       varbind;
+    oid_t           oid;
+} var_binds_t;
+
+/* preferred size of the responses to the manager of the current request, 0 if there is none */
+static u16t response_budget = 0;
+
 /*-----------------------------------------------------------------------------------*/
 /*
- * Handle an SNMP GET request
+ * Set the preferred size of the responses to the manager of the next requests, 0 for none.
  */
-static s8t snmp_get(message_t* message)
+void snmp_response_budget(u16t budget)
 {
-    int i = 0;
-    varbind_t* ptr = message->pdu.varbind_first_ptr;
-    while (ptr) {
-        i++;
-        if (!mib_get(ptr)) {
-            message->pdu.error_status = ERROR_STATUS_NO_SUCH_NAME;
-            message->pdu.error_index = i;
-            break;
+    response_budget = budget;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Check the community of the message.
+ */
+static u8t snmp_community_equals(const message_t* const message, const char* community)
+{
+    return message->community_len == strlen(community) && !memcmp(community, message->community, message->community_len);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the next variable binding of the request.
+ * Returns 1 if there is one, 0 after the last one and a negative value if it can not be decoded.
+ */
+static s8t snmp_next_var_bind(var_binds_t* var_binds, varbind_t** varbind)
+{
+    s8t ret;
+    if (!var_binds->input) {
+        if (!(*varbind = var_binds->next_ptr)) {
+            return 0;
         }
-        ptr = ptr->next_ptr;
-    }    
-    return 0;
+        var_binds->next_ptr = (*varbind)->next_ptr;
+        return 1;
+    }
+
+    /* the previous variable binding is not needed any more */
+    arena_release(var_binds->mark);
+    if (var_binds->pos >= var_binds->len) {
+        return 0;
+    }
+    memset(&var_binds->varbind, 0, sizeof(varbind_t));
+    var_binds->varbind.oid_ptr = &var_binds->oid;
+    if ((ret = var_binds->codec->decode_var_bind(var_binds->input, var_binds->len, &var_binds->pos, &var_binds->varbind)) < 0) {
+        return ret;
+    }
+    *varbind = &var_binds->varbind;
+    return 1;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Handle an SNMP GETNEXT request
+ * Set the error status of the response to tooBig.
+ * An SNMPv1 response echoes the variable bindings of the request, an SNMPv2c or SNMPv3
+ * one has an empty variable binding list (RFC 3416, 4.2.1).
  */
-static s8t snmp_get_next(message_t* message)
+static void snmp_too_big(message_t* message)
 {
-    int i = 0;
-    varbind_t* ptr = message->pdu.varbind_first_ptr;
-    while (ptr) {
+    message->pdu.error_status = ERROR_STATUS_TOO_BIG;
+    message->pdu.error_index = 0;
+    if (message->version != SNMP_VERSION_1) {
+        message->pdu.varbind_first_ptr = 0;
+        message->pdu.varbind_index = 0;
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle an SNMP GET or GETNEXT request.
+ * Each variable binding is encoded into the output as soon as it is resolved, so a request takes the
+ * memory of a single variable binding whatever the number of them. If one of them is not found or
+ * the response does not fit, the error status is set and the response has to be encoded from the request.
+ */
+static s8t snmp_get(message_t* message, var_binds_t* var_binds, u8t* output, u16t* output_start, u16t* output_len, const u16t max_output_len)
+{
+    ber_stream_t stream;
+    varbind_t* ptr;
+    mib_object_t* object;
+    u16t i = 0;
+    u8t full = 0;
+    s8t ret;
+
+    if (var_binds->codec->stream_start(&stream, message, BER_TYPE_SNMP_RESPONSE, output, max_output_len) == -1) {
+        return -1;
+    }
+    while ((ret = snmp_next_var_bind(var_binds, &ptr)) == 1) {
         i++;
-        if (!mib_get_next(ptr)) {
+        if (message->pdu.request_type == BER_TYPE_SNMP_GET) {
+            object = mib_get(ptr);
+        } else {
+            object = mib_get_next(ptr);
+        }
+        if (!object) {
             message->pdu.error_status = ERROR_STATUS_NO_SUCH_NAME;
-            message->pdu.error_index = i;
-            break;
+            message->pdu.error_index = (u8t)min(i, 0xFF);
+            return 0;
+        }
+        /* the rest of the variable bindings is still resolved, a noSuchName error is reported instead of tooBig */
+        if (!full && var_binds->codec->stream_append(&stream, ptr) == -1) {
+            full = 1;
         }
-        ptr = ptr->next_ptr;
+    }
+    if (ret == -1) {
+        return -1;
+    } else if (ret == ERR_MEMORY_ALLOCATION) {
+        stats_memory_error();
+        message->pdu.error_status = ERROR_STATUS_GEN_ERR;
+        message->pdu.error_index = 0;
+    } else if (full) {
+        snmp_log("too big response\n");
+        snmp_too_big(message);
+    } else {
+        var_binds->codec->stream_finish(&stream);
+        *output_start = stream.start;
+        *output_len = stream.len;
     }
     return 0;
 }
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Append a variable binding to a GETBULK response kept within the budget.
+ * The first variable binding may take the whole output, so the manager always makes progress.
+ */
+static s8t snmp_bulk_append(ber_stream_t* stream, const codec_t* codec, const varbind_t* const varbind, const u16t header_len, const u16t max_output_len)
+{
+    if (codec->stream_append(stream, varbind) != -1) {
+        return 0;
+    }
+    if (stream->len != header_len || stream->max_len == max_output_len) {
+        return -1;
+    }
+    stream->max_len = max_output_len;
+    if (codec->stream_append(stream, varbind) == -1) {
+        return -1;
+    }
+    /* nothing else is appended over the budget */
+    stream->max_len = 0;
+    return 0;
+}
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Handle an SNMP SET request
+ * Handle an SNMP GETBULK request.
+ * The variable bindings are encoded into the output as soon as they are resolved,
+ * and the response is cut at the last variable binding that fits into the budget.
  */
-static s8t snmp_set(message_t* message)
+static s8t snmp_get_bulk(message_t* message, const codec_t* codec, u8t* output, u16t* output_start, u16t* output_len, const u16t budget, const u16t max_output_len)
 {
-    varbind_t tmp_var_bind;
-    mib_object_list_t *var_index_ptr = 0, *cur_ptr = 0;
+    ber_stream_t stream;
+    u16t i, non_repeaters, header_len;
+    u8t end_of_mib, full;
+    varbind_t* ptr;
+    varbind_t* repeaters_ptr;
 
-    varbind_t* ptr = message->pdu.varbind_first_ptr;
-    u8t i = 0;
-    mib_object_t* object;
-    /* find mib objects and check their types */
-    while (ptr) {
-        i++;
-        memcpy(&tmp_var_bind, ptr, sizeof(varbind_t));
-        if (!(object = mib_get(&tmp_var_bind))) {
-            message->pdu.error_status = ERROR_STATUS_NO_SUCH_NAME;
-            message->pdu.error_index = i;
-            break;
-        } else {
-            if (!var_index_ptr) {
-                cur_ptr = var_index_ptr = mib_object_list_append(0, object);
-            } else {
-                cur_ptr = mib_object_list_append(cur_ptr, object);
-            }
-        }
-        if (tmp_var_bind.value_type != ptr->value_type) {
-            snmp_log("bad value type %d %d\n", tmp_var_bind.value_type, ptr->value_type);
-            message->pdu.error_status = ERROR_STATUS_BAD_VALUE;
-            message->pdu.error_index = i;
-            break;
+    if (codec->stream_start(&stream, message, BER_TYPE_SNMP_RESPONSE, output, max_output_len) == -1) {
+        return -1;
+    }
+    header_len = stream.len;
+    stream.max_len = max(budget, header_len);
+
+    /* the non-repeaters are handled as in the GETNEXT request */
+    non_repeaters = min(message->pdu.non_repeaters, message->pdu.varbind_len);
+    ptr = message->pdu.varbind_first_ptr;
+    full = 0;
+    for (i = 0; i < non_repeaters && !full; i++) {
+        if (!mib_get_next(ptr)) {
+            ptr->value_type = BER_TYPE_END_OF_MIB_VIEW;
         }
+        full = (snmp_bulk_append(&stream, codec, ptr, header_len, max_output_len) == -1);
         ptr = ptr->next_ptr;
     }
 
-    /* execute set operations for all mib objects in varbindings */
-    if (message->pdu.error_status == ERROR_STATUS_NO_ERROR) {
-        ptr = message->pdu.varbind_first_ptr;
-        cur_ptr = var_index_ptr;
-        i = 0;
-        while (ptr) {
-            i++;
-            if (mib_set(cur_ptr->value, ptr) == -1) {
-                message->pdu.error_status = ERROR_STATUS_GEN_ERR;
-                message->pdu.error_index = i;
-                mib_object_list_free(var_index_ptr);
-                return -1;
+    /* the repeaters are resolved max-repetitions times or until all of them reach the end of the MIB */
+    repeaters_ptr = ptr;
+    end_of_mib = 0;
+    for (i = 0; i < message->pdu.max_repetitions && repeaters_ptr && !end_of_mib && !full; i++) {
+        end_of_mib = 1;
+        for (ptr = repeaters_ptr; ptr && !full; ptr = ptr->next_ptr) {
+            if (!mib_get_next(ptr)) {
+                ptr->value_type = BER_TYPE_END_OF_MIB_VIEW;
+            } else {
+                end_of_mib = 0;
             }
-            ptr = ptr->next_ptr;
-            cur_ptr = cur_ptr->next_ptr;
+            full = (snmp_bulk_append(&stream, codec, ptr, header_len, max_output_len) == -1);
         }
     }
-    mib_object_list_free(var_index_ptr);
+
+    codec->stream_finish(&stream);
+    *output_start = stream.start;
+    *output_len = stream.len;
     return 0;
 }
 
-void free_message(message_t* message) {
-    /* free memory for the community string */
-    if (message->community) {
-        free(message->community);
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle an SNMP SET request.
+ * Each object is looked up once and all the values are validated before any of them is set,
+ * the objects set before a failing one are restored, so the request is applied as a whole or not at all.
+ */
+static s8t snmp_set(message_t* message)
+{
+    mib_set_entry_t stack_entries[VAR_BIND_LEN];
+    mib_set_entry_t* entries = stack_entries;
+    varbind_t* ptr;
+    u8t i, len = 0;
+
+    /* a longer request takes its entries from the arena, like its variable bindings */
+    if (message->pdu.varbind_len > VAR_BIND_LEN &&
+            (entries = arena_alloc(message->pdu.varbind_len * sizeof(mib_set_entry_t))) == 0) {
+        snmp_too_big(message);
+        return -1;
+    }
+
+    /* find the mib objects and check the values */
+    for (ptr = message->pdu.varbind_first_ptr; ptr; ptr = ptr->next_ptr, len++) {
+        if ((message->pdu.error_status = mib_set_validate(&entries[len], ptr)) != ERROR_STATUS_NO_ERROR) {
+            message->pdu.error_index = len + 1;
+            return -1;
+        }
     }
 
-    /* free memory for string values */
-    varbind_t* ptr = message->pdu.varbind_first_ptr;
-    while (ptr) {
-        if (message->pdu.request_type == BER_TYPE_SNMP_SET &&
-                ptr->value_type == BER_TYPE_OCTET_STRING && ptr->value.s_value.ptr) {
-            free(ptr->value.s_value.ptr);
+    /* set the values, undoing the ones already set if any of them fails */
+    for (i = 0; i < len; i++) {
+        if (mib_set_commit(&entries[i]) == -1) {
+            message->pdu.error_status = (message->version == SNMP_VERSION_1) ? ERROR_STATUS_GEN_ERR : ERROR_STATUS_COMMIT_FAILED;
+            message->pdu.error_index = i + 1;
+            while (i--) {
+                if (mib_set_undo(&entries[i]) == -1 && message->version != SNMP_VERSION_1) {
+                    message->pdu.error_status = ERROR_STATUS_UNDO_FAILED;
+                    message->pdu.error_index = 0;
+                }
+            }
+            return -1;
         }
-        oid_free(ptr->oid_ptr);
-        varbind_t* next_ptr = ptr->next_ptr;
-        free(ptr);
-        ptr = next_ptr;
     }
+
+    for (i = 0; i < len; i++) {
+        mib_set_finish(&entries[i]);
+    }
+    return 0;
 }
 
 /*-----------------------------------------------------------------------------------*/
 /*
- * Handle an SNMP request
+ * Handle an SNMP request.
+ * All the memory used by the request comes from the request arena, which is reset before returning.
  */
-s8t snmp_handler(const u8t* const input,  const u16t input_len, u8t* output, u16t* output_len, const u16t max_output_len)
+s8t snmp_handler(u8t* input,  const u16t input_len, u8t* output, u16t* output_start, u16t* output_len, const u16t max_output_len)
 {
     message_t message;
+    var_binds_t var_binds;
+    u16t max_len = max_output_len;
+    u16t pos;
+    u8t encoded = 0, streamed;
+    const codec_t* codec = &ber_codec;
+    u32t phase_start = stats_now();
+#if ENABLE_COMPACT_CODEC
+    if (COMPACT_IS_MESSAGE(input, input_len)) {
+        codec = &compact_codec;
+    }
+#endif /* ENABLE_COMPACT_CODEC */
     memset(&message, 0, sizeof(message_t));
+    /* a response encoded as a whole starts at the beginning of the output */
+    *output_start = 0;
     /* parse the incoming datagram and build an ASN.1 object */
-    s8t ret = ber_decode_request(input, input_len, &message);
+    s8t ret = codec->decode_header(input, input_len, &pos, &message);
+    /* the variable bindings of GET and GETNEXT requests are decoded one by one while they are resolved */
+    streamed = (message.pdu.request_type == BER_TYPE_SNMP_GET || message.pdu.request_type == BER_TYPE_SNMP_GETNEXT);
+    if (ret == 0 && !streamed) {
+        ret = codec->decode_var_binds(input, input_len, &pos, &message);
+    }
     if (ret == -1) {
         /* if the parse fails, it discards the datagram and performs no further actions. */
-        free_message(&message);
+        arena_reset();
         return -1;
     } else if (ret == ERR_MEMORY_ALLOCATION) {
-        snmp_info("here!!!");
+        stats_memory_error();
         message.pdu.error_status = ERROR_STATUS_GEN_ERR;
     }
 
+    /* a response acknowledges an Inform if it carries the community of the notifications,
+       it is not answered, neither is a report */
+    if (message.pdu.request_type == BER_TYPE_SNMP_RESPONSE || message.pdu.request_type == BER_TYPE_SNMP_REPORT) {
+        if (ret == 0 && message.version == SNMP_VERSION_2C && snmp_community_equals(&message, NOTIFICATION_COMMUNITY) &&
+                inform_acknowledge(message.pdu.request_id) != -1) {
+            snmp_log("inform %d acknowledged\n", message.pdu.request_id);
+        }
+        arena_reset();
+        return -1;
+    }
+
+    /* GETBULK is not defined in SNMPv1 */
+    if (message.pdu.request_type == BER_TYPE_SNMP_GETBULK && message.version == SNMP_VERSION_1) {
+        snmp_log("GETBULK request in an SNMPv1 message\n");
+        arena_reset();
+        return -1;
+    }
+
+#if ENABLE_SNMPv3
+    if (message.version == SNMP_VERSION_3) {
+        /* the response may not exceed the msgMaxSize of the manager, the security model replaces it with ours */
+        max_len = min(max_len, message.v3.msg_max_size);
+        /* the User-based Security Model takes the place of the community */
+        ret = usm_process_incoming(input, input_len, &message);
+        /* the type of an encrypted PDU is known only now */
+        if (ret == -1 || (ret == 0 && (message.pdu.request_type == BER_TYPE_SNMP_RESPONSE ||
+                message.pdu.request_type == BER_TYPE_SNMP_REPORT))) {
+            arena_reset();
+            return -1;
+        }
+    } else
+#endif /* ENABLE_SNMPv3 */
     /* authentication scheme */
-    if (message.pdu.error_status == ERROR_STATUS_NO_ERROR &&
-            strcmp(COMMUNITY_STRING, (char*)message.community)) {
+    if (message.pdu.error_status == ERROR_STATUS_NO_ERROR && !snmp_community_equals(&message, COMMUNITY_STRING)) {
         /* the protocol entity notes this failure, (possibly) generates a trap, and discards the datagram
          and performs no further actions. */
         message.pdu.error_status = (message.version == SNMP_VERSION_2C) ? ERROR_STATUS_NO_ACCESS : ERROR_STATUS_GEN_ERR;
         message.pdu.error_index = 0;
-        snmp_log("wrong community string \"%s\"\n", message.community);
+        snmp_log("wrong community string of length %d\n", message.community_len);
     } else {
         snmp_log("authentication passed\n");
     }
 
     /* request processing */
+    phase_start = stats_phase(STATS_PHASE_DECODE, phase_start);
+    stats_request(message.pdu.request_type);
     if (message.pdu.error_status == ERROR_STATUS_NO_ERROR) {
-        if (message.pdu.request_type == BER_TYPE_SNMP_GET) {
-            snmp_get(&message);
-        } else if (message.pdu.request_type == BER_TYPE_SNMP_GETNEXT) {
-            snmp_get_next(&message);
+        if (message.pdu.request_type == BER_TYPE_SNMP_GET || message.pdu.request_type == BER_TYPE_SNMP_GETNEXT) {
+            var_binds.codec = codec;
+            var_binds.input = streamed ? input : 0;
+            var_binds.len = input_len;
+            var_binds.pos = pos;
+            var_binds.mark = arena_mark();
+            var_binds.next_ptr = message.pdu.varbind_first_ptr;
+            if (snmp_get(&message, &var_binds, output, output_start, output_len, max_len) == -1) {
+                arena_reset();
+                return -1;
+            }
+            /* an error response is encoded from the variable bindings of the request */
+            encoded = (message.pdu.error_status == ERROR_STATUS_NO_ERROR);
         } else if (message.pdu.request_type == BER_TYPE_SNMP_SET) {
             snmp_set(&message);
+        } else if (message.pdu.request_type == BER_TYPE_SNMP_GETBULK) {
+            /* the response is encoded while processing the request, a GETBULK response can be cut
+             to the budget, the responses to the other requests are limited only by the maximum size */
+            if (snmp_get_bulk(&message, codec, output, output_start, output_len,
+                    response_budget ? min(response_budget, max_len) : max_len, max_len) == -1) {
+                arena_reset();
+                return -1;
+            }
+            encoded = 1;
         }
     }
+    phase_start = stats_phase(STATS_PHASE_DISPATCH, phase_start);
 
-    /* copy the value */
-    /* encode the response */
-    if (ber_encode_response(&message, output, output_len, input, input_len, max_output_len) == -1) {
+    /* encode the response unless it has been encoded while processing the request */
+    if (!encoded && codec->encode_response(&message, output, output_len, input, input_len, max_len) == -1) {
         /* Too big message.
          * If the size of the GetResponse-PDU generated as described
          * below would exceed a local limitation, then the receiving
@@ -199,14 +437,27 @@ s8t snmp_handler(const u8t* const input,  const u16t input_len, u8t* output, u16
          * value of the error-status field is tooBig, and the value
          * of the error-index field is zero.
          */
-        message.pdu.error_status = ERROR_STATUS_TOO_BIG;
-        message.pdu.error_index = 0;
-        if (ber_encode_response(&message, output, output_len, input, input_len, max_output_len) == -1) {
-            free_message(&message);
+        if (message.pdu.error_status == ERROR_STATUS_TOO_BIG) {
+            /* the tooBig response does not fit either */
+            arena_reset();
+            return -1;
+        }
+        snmp_too_big(&message);
+        if (codec->encode_response(&message, output, output_len, input, input_len, max_len) == -1) {
+            arena_reset();
             return -1;
         }
     }
-    free_message(&message);
+#if ENABLE_SNMPv3
+    if (message.version == SNMP_VERSION_3) {
+        usm_process_outgoing(output + *output_start, *output_len, &message);
+    }
+#endif /* ENABLE_SNMPv3 */
+    if (message.pdu.error_status == ERROR_STATUS_TOO_BIG) {
+        stats_too_big();
+    }
+    stats_phase(STATS_PHASE_ENCODE, phase_start);
+    arena_reset();
     snmp_log("processing finished\n---------------------------------\n");
     return 0;
 }
\ No newline at end of file
@@ -31,7 +31,13 @@
 
 #include "snmp.h"
 
-s8t snmp_handler(const u8t* const input,  const u16t input_len, u8t* output, u16t* output_len, const u16t max_output_len);
+void snmp_response_budget(u16t budget);
+
+/*
+ * Handles a request and writes the response into the output, returns -1 if it is not answered.
+ * The response takes output_len bytes starting at output + output_start.
+ */
+s8t snmp_handler(u8t* input,  const u16t input_len, u8t* output, u16t* output_start, u16t* output_len, const u16t max_output_len);
 
 #endif	/* __SNMP_PROTOCOL_H__ */
 
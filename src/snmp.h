@@ -35,20 +35,27 @@
 
 #define SNMP_VERSION_1					0
 #define SNMP_VERSION_2C					1
+#define SNMP_VERSION_3					3
 
-/** \brief OID item. */
-typedef struct oid_item_t {
-    OID_T               value;
-    struct oid_item_t*  next_ptr;
-} oid_item_t;
+/* msgFlags of an SNMPv3 message */
+#define SNMP_MSG_FLAG_AUTH                              0x01
+#define SNMP_MSG_FLAG_PRIV                              0x02
+#define SNMP_MSG_FLAG_REPORTABLE                        0x04
 
-/** \brief OID. */
+/* msgSecurityModel of the User-based Security Model */
+#define SNMP_SECURITY_MODEL_USM                         3
+
+/* length of the authentication parameters, the truncated HMAC */
+#define SNMP_AUTH_PARAMS_LEN                            12
+
+/** \brief OID stored as a contiguous array of sub-identifiers. */
 typedef struct oid_t {
-    struct oid_item_t* first_ptr;
-    u8t                len;
+    OID_T               values[OID_LEN];
+    u8t                 len;
 } oid_t;
 
-/** \brief Value of the variable binding. */
+/** \brief Value of the variable binding.
+ * String values of a request point into the input datagram. */
 typedef union {
     s32t            i_value;
     u32t            u_value;
@@ -56,13 +63,24 @@ typedef union {
         u8t*        ptr;
         u16t        len;
     } s_value;
+    const oid_t*    oid_value;
+    /* Counter64, kept out of the union so 32-bit values do not pay for it */
+    u64t*           u64_value;
 } varbind_value_t;
 
+/* the value of a Counter64 variable binding, which may have no storage yet */
+#define VARBIND_U64(value) ((value).u64_value ? *(value).u64_value : 0)
+
 /** \brief Variable binding. */
 typedef struct varbind_t {
     oid_t*              oid_ptr;
     u8t                 value_type;
     varbind_value_t     value;
+    /* the whole variable binding BER encoded in advance, if encoded_ptr is set */
+    const u8t*          encoded_ptr;
+    u16t                encoded_len;
+    /* the encoded variable binding is in the program memory */
+    u8t                 encoded_pgm;
     struct varbind_t*   next_ptr;
 } varbind_t;
 
@@ -74,14 +92,49 @@ typedef struct {
     u8t         error_index;
     varbind_t*  varbind_first_ptr;
     u8t         varbind_len;
-    /* the index of the first varbind byte in the input message */
+    /* the index of the first varbind byte in the input message, an error response copies the variable
+       bindings of the request from there, or has the ones of varbind_first_ptr if it is 0 */
     u16t        varbind_index;
+    /* parameters of a GetBulk request, sent in place of error-status and error-index */
+    u16t        non_repeaters;
+    u16t        max_repetitions;
 } pdu_t;
 
+#if ENABLE_SNMPv3
+/** \brief Header and security parameters of an SNMPv3 message.
+ * The strings point into the input datagram, or into the security module for a response. */
+typedef struct {
+    s32t    msg_id;
+    s32t    msg_max_size;
+    u8t     msg_flags;
+    u8t*    engine_id;
+    u8t     engine_id_len;
+    s32t    engine_boots;
+    s32t    engine_time;
+    u8t*    user;
+    u8t     user_len;
+    /* the index of the authentication parameters in the message, 0 if they are absent */
+    u16t    auth_params_pos;
+    u8t*    priv_params;
+    u8t     priv_params_len;
+    /* the index of the scoped PDU in the message, it is encrypted in place if privacy is used */
+    u16t    scoped_pdu_pos;
+    u8t*    context_engine_id;
+    u8t     context_engine_id_len;
+    u8t*    context_name;
+    u8t     context_name_len;
+} message_v3_t;
+#endif /* ENABLE_SNMPv3 */
+
 /** \brief Request data structure. */
 typedef struct {
     u8t     version;
+    /* points into the input datagram, not zero-terminated */
     u8t*    community;
+    u16t    community_len;
+#if ENABLE_SNMPv3
+    message_v3_t v3;
+#endif /* ENABLE_SNMPv3 */
     pdu_t   pdu;
 } message_t;
 
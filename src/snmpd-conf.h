@@ -34,19 +34,115 @@
 /* maximum length of the payload of incoming and outgoing UDP datagrams */
 #define MAX_BUF_SIZE 800//UIP_APPDATA_SIZE
 
+/** UDP payload fitting into a single 802.15.4 frame: 127 bytes less the MAC header, the FCS and the compressed IPv6 and UDP headers */
+#define LINK_PAYLOAD_SIZE       80
+
+/** preferred size of a response sent over 6LoWPAN, GETBULK responses are cut to it to avoid fragmentation;
+    the Linux transport has no budget, max-repetitions and msgMaxSize limit its responses */
+#define RESPONSE_BUDGET         LINK_PAYLOAD_SIZE
+
+/** preferred response sizes of particular managers, pairs of the last 16 bits of the address and the size */
+//#define MANAGER_BUDGETS         {{0x0001, MAX_BUF_SIZE}}
+
 /** community string */
 #define COMMUNITY_STRING        "public"
 
-/** maximum number of variable bindings in a request */
+/** number of variable bindings the request arena is sized for, larger requests are answered with a genErr;
+    GET and GETNEXT are decoded one by one */
 #define VAR_BIND_LEN            4
 
+/** enables the heap fallback of the requests which do not fit into the request arena, the host build only:
+    the RAM taken by a request on the mote is bounded by the arena */
+#ifndef ENABLE_ARENA_HEAP
+#define ENABLE_ARENA_HEAP       0
+#endif
+
 /** maximum number of elements in an OID */
 #define OID_LEN                 15
 
+/** number of objects generated from mib.def, mib-gen.c does not compile if they do not fit */
+#define MIB_GENERATED_LEN       9
+
+/** number of objects added at run time with add_scalar and add_table: the agent statistics table and 3 spare ones */
+#define MIB_RUNTIME_LEN         4
+
 /** maximum number of entries in the MIB */
-#define MIB_LEN                 8
+#define MIB_LEN                 (MIB_GENERATED_LEN + MIB_RUNTIME_LEN)
+
+/** number of managers whose GETNEXT walk positions are remembered */
+#define MIB_CURSOR_LEN          2
 
 #define OID_T   u16t
 
+/** community string of the notifications */
+#define NOTIFICATION_COMMUNITY  COMMUNITY_STRING
+
+/** length notifications are merged up to, merged notifications are sent in separate datagrams above it,
+    so a coalesced PDU fits into a single frame */
+#define NOTIFICATION_MAX_LEN    LINK_PAYLOAD_SIZE
+
+/** maximum length of a notification, one longer than NOTIFICATION_MAX_LEN is sent on its own */
+#define NOTIFICATION_BUF_SIZE   200
+
+/** time in clock ticks notifications are collected before they are sent */
+#define NOTIFICATION_WINDOW     (CLOCK_SECOND / 2)
+
+/** number of Informs waiting for an acknowledgement */
+#define INFORM_QUEUE_LEN        2
+
+/** maximum length of an Inform */
+#define INFORM_MAX_LEN          128
+
+/** number of retransmissions of an Inform */
+#define INFORM_RETRIES          3
+
+/** time in clock ticks before the first retransmission of an Inform, doubled after each one */
+#define INFORM_TIMEOUT          (2 * CLOCK_SECOND)
+
+/** enables the compact encoding of the messages, a request is answered in the encoding it comes in */
+#define ENABLE_COMPACT_CODEC    1
+
+/** size of the ring buffer of the trace records */
+#define TRACE_BUF_SIZE          256
+
+/** time in clock ticks between the batches of the trace records sent to the collector */
+#define TRACE_INTERVAL          (2 * CLOCK_SECOND)
+
+/** enables the statistics of the agent in the private subtree AGENT_STATS_OID */
+#define ENABLE_AGENT_STATS      1
+
+/** subtree of the statistics, under the enterprise number reserved for documentation (RFC 5612) */
+#define AGENT_STATS_OID         {1, 3, 6, 1, 4, 1, 32473, 1, 0}
+
+/** number of the buckets of the latency histograms */
+#define STATS_HISTOGRAM_LEN     8
+
+/** the bucket i of a latency histogram counts the durations below 2^(STATS_BUCKET_BITS * (i + 1)) clock units,
+ the last one counts the longer ones as well */
+#ifndef STATS_BUCKET_BITS
+#define STATS_BUCKET_BITS       1
+#endif
+
+/** enables SNMPv3 messages secured by the User-based Security Model */
+#define ENABLE_SNMPv3           1
+
+/** snmpEngineID of the agent, the enterprise 0 with a text suffix (RFC 3411, format 4) */
+#define SNMP_ENGINE_ID          {0x80, 0x00, 0x00, 0x00, 0x04, 'c', 'o', 'n', 't', 'i', 'k', 'i'}
+
+/** SNMPv3 user, authenticated by HMAC-SHA-96 */
+#define USM_USER                "admin"
+
+/** authentication password of the SNMPv3 user, at least 8 characters long */
+#define USM_AUTH_PASSWORD       "adminpassword"
+
+/** enables the encryption of SNMPv3 messages by AES-128 (RFC 3826) */
+#define ENABLE_USM_PRIVACY      1
+
+/** privacy password of the SNMPv3 user, at least 8 characters long */
+#define USM_PRIV_PASSWORD       "adminprivacy"
+
+/** number of seconds the time of an authenticated message may differ from the engine time */
+#define USM_TIME_WINDOW         150
+
 #endif	/* __SNMP_CONF_H__ */
 
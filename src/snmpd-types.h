@@ -36,6 +36,7 @@
 #define s16t signed short
 #define u32t unsigned long
 #define s32t signed long
+#define u64t unsigned long long
 
 
 #endif /* __SNMPD_TYPES_H__ */
\ No newline at end of file
@@ -28,17 +28,130 @@
 
 #include "snmpd.h"
 #include "snmpd-conf.h"
-#include "snmp-protocol.h"
+#include "transport.h"
 #include "mib-init.h"
+#include "notification.h"
+#include "usm.h"
+#include "stats.h"
 #include "logging.h"
 
+#define TRACE_FILE 6
+
 #define UDP_IP_BUF   ((struct uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
 /* UDP connection */
 static struct uip_udp_conn *udpconn;
 
+/* UDP connection to the manager receiving notifications */
+static struct uip_udp_conn *notification_conn;
+
+/* coalescing window of the pending notifications */
+static struct etimer notification_timer;
+
+/* posted when a notification PDU is started */
+static process_event_t notification_event;
+
+/* retransmission timer of the Informs */
+static struct etimer inform_timer;
+
+/* posted when an Inform is sent */
+static process_event_t inform_event;
+
+#if DEBUG || INFO
+/* UDP connection to the host collecting the trace records */
+static struct uip_udp_conn *trace_conn;
+
+/* period of sending the trace records */
+static struct etimer trace_timer;
+#endif /* DEBUG || INFO */
+
 PROCESS(snmpd_process, "SNMP daemon process");
 
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Send a notification to the manager.
+ */
+static void notification_send(const u8t* data, u16t len)
+{
+    uip_udp_packet_send(notification_conn, data, len);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Raise a notification. Notifications raised within the coalescing window are sent together.
+ */
+s8t snmpd_notify(const oid_t* const trap_oid, const varbind_t* varbinds)
+{
+    s8t ret = notification_raise(trap_oid, varbinds);
+    if (ret == 1) {
+        /* the window is opened in the context of the SNMP process */
+        process_post(&snmpd_process, notification_event, NULL);
+    }
+    return ret == -1 ? -1 : 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Send an Inform, it is retransmitted until the manager acknowledges it.
+ */
+s8t snmpd_inform(const oid_t* const trap_oid, const varbind_t* varbinds)
+{
+    if (inform_raise(trap_oid, varbinds, clock_time(), INFORM_TIMEOUT) == -1) {
+        return -1;
+    }
+    process_post(&snmpd_process, inform_event, NULL);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Retransmit the due Informs and set the timer to the next retransmission.
+ */
+static void inform_schedule()
+{
+    u16t now = clock_time();
+    u16t next;
+    if (inform_poll(now, &next)) {
+        etimer_set(&inform_timer, (u16t)(next - now));
+    } else {
+        etimer_stop(&inform_timer);
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Send the trace records to the collector, a batch per datagram small enough for a single frame.
+ */
+void snmpd_trace_flush()
+{
+#if DEBUG || INFO
+    u8t batch[LINK_PAYLOAD_SIZE];
+    u16t len;
+    while ((len = trace_drain(batch, LINK_PAYLOAD_SIZE)) != 0) {
+        uip_udp_packet_send(trace_conn, batch, len);
+    }
+#endif /* DEBUG || INFO */
+}
+
+#if ENABLE_AGENT_STATS
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Clock of the statistics, the clock ticks extended to 32 bits.
+ * It is read several times per request, so a wrap of the clock is never missed between two reads.
+ */
+static u32t stats_clock()
+{
+    static u32t high = 0;
+    static u16t last = 0;
+    u16t now = clock_time();
+    if (now < last) {
+        high += 0x10000UL;
+    }
+    last = now;
+    return high | now;
+}
+#endif /* ENABLE_AGENT_STATS */
+
 /*-----------------------------------------------------------------------------------*/
 /*
  * UDP handler.
@@ -46,30 +159,30 @@ PROCESS(snmpd_process, "SNMP daemon process");
 static void udp_handler(process_event_t ev, process_data_t data)
 {
     u8t respond[MAX_BUF_SIZE];
-    u16t resp_len;
-    
-    #if DEBUG && CONTIKI_TARGET_AVR_RAVEN
-    u8t request[MAX_BUF_SIZE];
-    u16t req_len;
-    #endif /* DEBUG && CONTIKI_TARGET_AVR_RAVEN */
+    u16t resp_start, resp_len;
+    transport_peer_t peer;
+    uip_ipaddr_t ripaddr;
+    u16_t rport;
+
     if (ev == tcpip_event && uip_newdata()) {
-        uip_ipaddr_copy(&udpconn->ripaddr, &UDP_IP_BUF->srcipaddr);
-        udpconn->rport = UDP_IP_BUF->srcport;
-        
-        #if DEBUG && CONTIKI_TARGET_AVR_RAVEN
-        req_len = uip_datalen();
-        memcpy(request, uip_appdata, req_len);
-        if (snmp_handler(request, &req_len, respond, resp_len, MAX_BUF_SIZE) == -1) {
-            return;
-        }
-        #else
+        uip_ipaddr_copy(&ripaddr, &UDP_IP_BUF->srcipaddr);
+        rport = UDP_IP_BUF->srcport;
+        peer.addr = UDP_IP_BUF->srcipaddr.u16[7];
+        peer.port = UDP_IP_BUF->srcport;
+        peer.budget = RESPONSE_BUDGET;
+        #if ENABLE_SNMPv3
+        usm_set_time(clock_seconds());
+        #endif /* ENABLE_SNMPv3 */
 
-        if (snmp_handler((u8_t*)uip_appdata, uip_datalen(), respond, &resp_len, MAX_BUF_SIZE) == -1) {
+        if (transport_handle(&peer, (u8_t*)uip_appdata, uip_datalen(), respond, &resp_start, &resp_len, MAX_BUF_SIZE) == -1) {
             return;
         }
-        #endif /* DEBUG && CONTIKI_TARGET_AVR_RAVEN */
-        uip_udp_packet_send(udpconn, respond, resp_len);
 
+        /* the connection is bound to the manager only while the response is sent,
+           otherwise it would accept datagrams from that manager alone */
+        uip_ipaddr_copy(&udpconn->ripaddr, &ripaddr);
+        udpconn->rport = rport;
+        uip_udp_packet_send(udpconn, respond + resp_start, resp_len);
         memset(&udpconn->ripaddr, 0, sizeof(udpconn->ripaddr));
         udpconn->rport = 0;
     }
@@ -81,15 +194,55 @@ static void udp_handler(process_event_t ev, process_data_t data)
  *  Entry point of the SNMP server.
  */
 PROCESS_THREAD(snmpd_process, ev, data) {
+        uip_ipaddr_t manager_addr;
+        #if DEBUG || INFO
+        uip_ipaddr_t collector_addr;
+        #endif /* DEBUG || INFO */
+
 	PROCESS_BEGIN();
 	udpconn = udp_new(NULL, HTONS(0), NULL);
 	udp_bind(udpconn, HTONS(LISTEN_PORT));
 
+        NOTIFICATION_MANAGER(&manager_addr);
+        notification_conn = udp_new(&manager_addr, HTONS(NOTIFICATION_PORT), NULL);
+        notification_event = process_alloc_event();
+        inform_event = process_alloc_event();
+        notification_init(&notification_send, manager_addr.u16[7], HTONS(NOTIFICATION_PORT));
+
+        #if DEBUG || INFO
+        TRACE_COLLECTOR(&collector_addr);
+        trace_conn = udp_new(&collector_addr, HTONS(TRACE_PORT), NULL);
+        etimer_set(&trace_timer, TRACE_INTERVAL);
+        #endif /* DEBUG || INFO */
+
+        #if ENABLE_SNMPv3
+        if (usm_init() == -1) {
+            snmp_log("error occurs while initializing the security model\n");
+        }
+        #endif /* ENABLE_SNMPv3 */
+
+        #if ENABLE_AGENT_STATS
+        stats_set_clock(&stats_clock);
+        #endif /* ENABLE_AGENT_STATS */
+
         /* init MIB */
         if (mib_init() != -1) {
             while(1) {
                 PROCESS_YIELD();
-                udp_handler(ev, data);
+                if (ev == notification_event) {
+                    etimer_set(&notification_timer, NOTIFICATION_WINDOW);
+                } else if (ev == PROCESS_EVENT_TIMER && data == &notification_timer) {
+                    notification_flush();
+                } else if (ev == inform_event || (ev == PROCESS_EVENT_TIMER && data == &inform_timer)) {
+                    inform_schedule();
+                #if DEBUG || INFO
+                } else if (ev == PROCESS_EVENT_TIMER && data == &trace_timer) {
+                    snmpd_trace_flush();
+                    etimer_reset(&trace_timer);
+                #endif /* DEBUG || INFO */
+                } else {
+                    udp_handler(ev, data);
+                }
             }
         } else {
             snmp_log("error occurs while initializing the MIB\n");
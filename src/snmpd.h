@@ -23,9 +23,27 @@
 #define __SNMPD_H__
 
 #include "contiki-net.h"
+#include "snmp.h"
 
 #define LISTEN_PORT 161
 
+#define NOTIFICATION_PORT 162
+
+/* address of the manager receiving notifications */
+#define NOTIFICATION_MANAGER(addr) uip_ip6addr(addr, 0xaaaa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001)
+
+#define TRACE_PORT 12345
+
+/* address of the host collecting the trace records, decoded there by tools/tracedump.py */
+#define TRACE_COLLECTOR(addr) uip_ip6addr(addr, 0xaaaa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001)
+
 PROCESS_NAME(snmpd_process);
 
+s8t snmpd_notify(const oid_t* const trap_oid, const varbind_t* varbinds);
+
+s8t snmpd_inform(const oid_t* const trap_oid, const varbind_t* varbinds);
+
+/* Sends the pending trace records to the collector without waiting for the next period. */
+void snmpd_trace_flush();
+
 #endif /* __SNMPD_H__ */
@@ -0,0 +1,254 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Statistics of the agent itself, exposed in a private MIB subtree
+ *
+ *         The subtree AGENT_STATS_OID holds
+ *
+ *         .1.t        requests of the PDU type t: 1 - GET, 2 - GETNEXT, 3 - SET, 4 - GETBULK
+ *         .2.p.b      requests whose phase p took the time of the bucket b (see STATS_BUCKET_BITS),
+ *                     the phases are 1 - decoding and authentication, 2 - dispatch to the MIB,
+ *                     3 - encoding and securing the response
+ *         .3.0        the most bytes of the request arena, with its heap blocks, a request has taken
+ *         .4.0        requests answered with a genErr as their memory could not be allocated
+ *         .5.0        tooBig responses
+ *
+ *         The phases are timed in clock ticks on the mote and in nanoseconds on the host.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#include "stats.h"
+#include "ber.h"
+#include "utils.h"
+
+#if ENABLE_AGENT_STATS
+
+/* the request types counted, in the order of their objects */
+static const u8t request_types[] = {
+    BER_TYPE_SNMP_GET, BER_TYPE_SNMP_GETNEXT, BER_TYPE_SNMP_SET, BER_TYPE_SNMP_GETBULK
+};
+
+#define REQUEST_TYPE_LEN        sizeof(request_types)
+#define HISTOGRAMS_LEN          (STATS_PHASE_LEN * STATS_HISTOGRAM_LEN)
+
+/* number of the objects in the subtree */
+#define STATS_OBJECT_LEN        (REQUEST_TYPE_LEN + HISTOGRAMS_LEN + 3)
+
+static u32t requests[REQUEST_TYPE_LEN];
+static u32t latency[STATS_PHASE_LEN][STATS_HISTOGRAM_LEN];
+static u32t too_big;
+static u32t memory_errors;
+
+static stats_clock_t stats_clock = 0;
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the clock the phases are timed with.
+ */
+void stats_set_clock(stats_clock_t clock)
+{
+    stats_clock = clock;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the current time, 0 if there is no clock.
+ */
+u32t stats_now()
+{
+    return stats_clock ? (stats_clock)() : 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Add the time since start to the histogram of the phase and return the current time.
+ */
+u32t stats_phase(const u8t phase, const u32t start)
+{
+    u32t now, duration;
+    u8t bucket = 0;
+    if (!stats_clock) {
+        return 0;
+    }
+    now = (stats_clock)();
+    duration = now - start;
+    while (bucket < STATS_HISTOGRAM_LEN - 1 && (duration >> (STATS_BUCKET_BITS * (bucket + 1)))) {
+        bucket++;
+    }
+    latency[phase][bucket]++;
+    return now;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Count a request of the given PDU type.
+ */
+void stats_request(const u8t request_type)
+{
+    u8t i;
+    for (i = 0; i < REQUEST_TYPE_LEN; i++) {
+        if (request_types[i] == request_type) {
+            requests[i]++;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Count a tooBig response.
+ */
+void stats_too_big()
+{
+    too_big++;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Count a request whose memory could not be allocated.
+ */
+void stats_memory_error()
+{
+    memory_errors++;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the OID suffix of the i-th object of the subtree and its length,
+ * the objects are numbered in the OID order.
+ */
+static u8t stats_object_oid(u8t i, OID_T* oid)
+{
+    if (i < REQUEST_TYPE_LEN) {
+        oid[0] = 1;
+        oid[1] = i + 1;
+        return 2;
+    }
+    i -= REQUEST_TYPE_LEN;
+    if (i < HISTOGRAMS_LEN) {
+        oid[0] = 2;
+        oid[1] = i / STATS_HISTOGRAM_LEN + 1;
+        oid[2] = i % STATS_HISTOGRAM_LEN + 1;
+        return 3;
+    }
+    i -= HISTOGRAMS_LEN;
+    oid[0] = i + 3;
+    oid[1] = 0;
+    return 2;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the value of the i-th object of the subtree.
+ */
+static void stats_object_value(u8t i, varbind_t* varbind)
+{
+    varbind->value_type = BER_TYPE_COUNTER;
+    if (i < REQUEST_TYPE_LEN) {
+        varbind->value.u_value = requests[i];
+        return;
+    }
+    i -= REQUEST_TYPE_LEN;
+    if (i < HISTOGRAMS_LEN) {
+        varbind->value.u_value = latency[i / STATS_HISTOGRAM_LEN][i % STATS_HISTOGRAM_LEN];
+        return;
+    }
+    i -= HISTOGRAMS_LEN;
+    if (i == 0) {
+        varbind->value_type = BER_TYPE_GAUGE;
+        varbind->value.u_value = arena_peak();
+    } else if (i == 1) {
+        varbind->value.u_value = memory_errors;
+    } else {
+        varbind->value.u_value = too_big;
+    }
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Compare OID suffixes in the lexicographical order.
+ */
+static s8t stats_oid_cmp(const OID_T* oid1, const u8t len1, const OID_T* oid2, const u8t len2)
+{
+    u8t i;
+    for (i = 0; i < len1 && i < len2; i++) {
+        if (oid1[i] != oid2[i]) {
+            return oid1[i] < oid2[i] ? -1 : 1;
+        }
+    }
+    return len1 == len2 ? 0 : (len1 < len2 ? -1 : 1);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Get the value of an object of the subtree.
+ */
+static s8t getAgentStats(mib_object_t* object, OID_T* oid, u8t len)
+{
+    OID_T object_oid[3];
+    u8t i, object_len;
+    for (i = 0; i < STATS_OBJECT_LEN; i++) {
+        object_len = stats_object_oid(i, object_oid);
+        if (!stats_oid_cmp(object_oid, object_len, oid, len)) {
+            stats_object_value(i, &object->varbind);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Replace the OID suffix with the one of the next object of the subtree.
+ */
+static s8t getNextAgentStatsOid(mib_object_t* object, OID_T* oid, u8t* len, u8t max_len)
+{
+    OID_T object_oid[3];
+    u8t i, object_len;
+    for (i = 0; i < STATS_OBJECT_LEN; i++) {
+        object_len = stats_object_oid(i, object_oid);
+        if (stats_oid_cmp(object_oid, object_len, oid, *len) > 0) {
+            if (object_len > max_len) {
+                return -1;
+            }
+            memcpy(oid, object_oid, object_len * sizeof(OID_T));
+            *len = object_len;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Add the subtree of the statistics to the MIB.
+ */
+s8t stats_mib_init()
+{
+    static const OID_T prefix[] = AGENT_STATS_OID;
+    return add_table(prefix, &getAgentStats, &getNextAgentStatsOid, 0);
+}
+
+#endif /* ENABLE_AGENT_STATS */
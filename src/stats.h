@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Statistics of the agent itself, exposed in a private MIB subtree
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __STATS_H__
+#define	__STATS_H__
+
+#include "snmp.h"
+#include "mib.h"
+
+/* phases of the handling of a request timed in the latency histograms */
+#define STATS_PHASE_DECODE      0
+#define STATS_PHASE_DISPATCH    1
+#define STATS_PHASE_ENCODE      2
+#define STATS_PHASE_LEN         3
+
+/** \brief Clock of the platform, clock ticks on the mote and nanoseconds on the host. */
+typedef u32t (*stats_clock_t)();
+
+#if ENABLE_AGENT_STATS
+
+/* Sets the clock the phases are timed with, they are not timed without one. */
+void stats_set_clock(stats_clock_t clock);
+
+u32t stats_now();
+
+/* Adds the time since start to the histogram of the phase and returns the current time. */
+u32t stats_phase(const u8t phase, const u32t start);
+
+void stats_request(const u8t request_type);
+
+void stats_too_big();
+
+void stats_memory_error();
+
+/* Adds the subtree of the statistics to the MIB. */
+s8t stats_mib_init();
+
+#else
+
+#define stats_set_clock(clock)
+#define stats_request(request_type)
+#define stats_too_big()
+#define stats_memory_error()
+
+static inline u32t stats_now()
+{
+    return 0;
+}
+
+static inline u32t stats_phase(const u8t phase, const u32t start)
+{
+    return start;
+}
+
+#endif /* ENABLE_AGENT_STATS */
+
+#endif	/* __STATS_H__ */
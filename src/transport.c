@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Handling of the datagrams of the managers independent of the transport
+ *
+ *         A transport (uIP in snmpd.c, the Linux sockets in host/snmpd-linux.c) receives
+ *         the requests and sends the responses, the state kept for each manager is
+ *         selected here before the request is handled.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include "transport.h"
+#include "snmp-protocol.h"
+#include "mib.h"
+#include "notification.h"
+
+#ifdef MANAGER_BUDGETS
+/** \brief Preferred response size of a manager. */
+typedef struct {
+    u16t    addr;
+    u16t    budget;
+} manager_budget_t;
+
+static const manager_budget_t manager_budgets[] = MANAGER_BUDGETS;
+#endif /* MANAGER_BUDGETS */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Select the preferred response size of the manager, the one of the link unless the manager has its own.
+ */
+static void transport_budget_select(const transport_peer_t* const peer)
+{
+    u16t budget = peer->budget;
+#ifdef MANAGER_BUDGETS
+    u8t i;
+    /* the address is stored in the network byte order */
+    u16t addr = ((u8t*)&peer->addr)[0] << 8 | ((u8t*)&peer->addr)[1];
+    for (i = 0; i < sizeof(manager_budgets) / sizeof(manager_budget_t); i++) {
+        if (manager_budgets[i].addr == addr) {
+            budget = manager_budgets[i].budget;
+        }
+    }
+#endif /* MANAGER_BUDGETS */
+    snmp_response_budget(budget);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Handle a request of a manager.
+ */
+s8t transport_handle(const transport_peer_t* const peer, u8t* input, const u16t input_len, u8t* output, u16t* output_start, u16t* output_len, const u16t max_output_len)
+{
+    /* managers are told apart by the interface identifier and the port */
+    mib_cursor_select(peer->addr ^ peer->port);
+    inform_sender_select(peer->addr, peer->port);
+    transport_budget_select(peer);
+    return snmp_handler(input, input_len, output, output_start, output_len, max_output_len);
+}
@@ -0,0 +1,47 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         Handling of the datagrams of the managers independent of the transport
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __TRANSPORT_H__
+#define	__TRANSPORT_H__
+
+#include "snmp.h"
+
+/** \brief Manager a datagram comes from, as seen by the transport. */
+typedef struct {
+    /* the last 16 bits of the address as they are stored in it */
+    u16t    addr;
+    /* the port as it is stored in the UDP header */
+    u16t    port;
+    /* preferred size of a response on the link of the transport, 0 if there is none */
+    u16t    budget;
+} transport_peer_t;
+
+/* Handles a request of the manager, the response is returned as by snmp_handler. */
+s8t transport_handle(const transport_peer_t* const peer, u8t* input, const u16t input_len, u8t* output, u16t* output_start, u16t* output_len, const u16t max_output_len);
+
+#endif	/* __TRANSPORT_H__ */
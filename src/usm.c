@@ -0,0 +1,429 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         User-based Security Model of SNMPv3 (RFC 3414)
+ *
+ *         A single user authenticated by HMAC-SHA-96 and optionally encrypted by AES-128-CFB
+ *         is supported. Its localized keys take a megabyte of hashing each to compute, so they
+ *         are computed once and kept in the EEPROM together with the number of engine boots
+ *         where the target provides one. Scoped PDUs are encrypted and decrypted in place.
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#include <string.h>
+
+#if CONTIKI_TARGET_AVR_RAVEN
+#include <avr/eeprom.h>
+#endif /* CONTIKI_TARGET_AVR_RAVEN */
+
+#include "usm.h"
+#include "sha1.h"
+#include "aes.h"
+#include "ber.h"
+#include "utils.h"
+#include "stats.h"
+#include "logging.h"
+
+#define TRACE_FILE 7
+
+#if ENABLE_SNMPv3
+
+/* last but one sub-identifiers of the usmStats counters */
+#define USM_STATS_UNSUPPORTED_SEC_LEVELS    1
+#define USM_STATS_NOT_IN_TIME_WINDOWS       2
+#define USM_STATS_UNKNOWN_USER_NAMES        3
+#define USM_STATS_UNKNOWN_ENGINE_IDS        4
+#define USM_STATS_WRONG_DIGESTS             5
+#define USM_STATS_DECRYPTION_ERRORS         6
+#define USM_STATS_LEN                       6
+
+/* the security flags the user may ask for */
+#if ENABLE_USM_PRIVACY
+#define USM_SECURITY_FLAGS                  (SNMP_MSG_FLAG_AUTH | SNMP_MSG_FLAG_PRIV)
+#else
+#define USM_SECURITY_FLAGS                  SNMP_MSG_FLAG_AUTH
+#endif /* ENABLE_USM_PRIVACY */
+
+/* length of the privacy parameters, the salt of the initialization vector */
+#define USM_SALT_LEN                        8
+
+/* the maximum value of snmpEngineBoots and snmpEngineTime */
+#define USM_MAX_INTEGER                     0x7FFFFFFFL
+
+static u8t engine_id[] = SNMP_ENGINE_ID;
+static s32t engine_boots;
+static s32t engine_time;
+
+static const u8t user[] = USM_USER;
+static const u8t auth_password[] = USM_AUTH_PASSWORD;
+
+/* the authentication key localized to the engine */
+static u8t auth_key[SHA1_DIGEST_LEN];
+
+#if ENABLE_USM_PRIVACY
+static const u8t priv_password[] = USM_PRIV_PASSWORD;
+
+/* the key schedule of the privacy key, expanded once */
+static aes_ctx_t priv_ctx;
+
+/* the salt of the last outgoing message, the engine boots followed by a counter */
+static u8t salt[USM_SALT_LEN];
+static u32t salt_counter;
+#endif /* ENABLE_USM_PRIVACY */
+
+static u32t usm_stats[USM_STATS_LEN];
+
+/* the variable binding of a report, usmStats.X.0 */
+static oid_t report_oid = {{1, 3, 6, 1, 6, 3, 15, 1, 1, 0, 0}, 11};
+
+#if CONTIKI_TARGET_AVR_RAVEN
+/** \brief Localized keys with the first bytes of the digest of the passwords and the engine ID they are computed from. */
+typedef struct {
+    u8t     tag[4];
+    u8t     auth_key[SHA1_DIGEST_LEN];
+#if ENABLE_USM_PRIVACY
+    u8t     priv_key[AES_KEY_LEN];
+#endif /* ENABLE_USM_PRIVACY */
+} usm_key_cache_t;
+
+static usm_key_cache_t EEMEM key_cache;
+static uint32_t EEMEM boots_cache;
+#endif /* CONTIKI_TARGET_AVR_RAVEN */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Convert the password to a key and localize it to the engine (RFC 3414, A.2.2).
+ */
+static void usm_localize_key(const u8t* password, const u8t password_len, u8t* key)
+{
+    u8t block[SHA1_BLOCK_LEN];
+    sha1_ctx_t ctx;
+    u16t i;
+    u8t j, index = 0;
+
+    /* the digest of a megabyte of the repeated password */
+    sha1_init(&ctx);
+    for (i = 0; i < 1048576UL / SHA1_BLOCK_LEN; i++) {
+        for (j = 0; j < SHA1_BLOCK_LEN; j++) {
+            block[j] = password[index++];
+            if (index == password_len) {
+                index = 0;
+            }
+        }
+        sha1_update(&ctx, block, SHA1_BLOCK_LEN);
+    }
+    sha1_final(&ctx, key);
+
+    sha1_init(&ctx);
+    sha1_update(&ctx, key, SHA1_DIGEST_LEN);
+    sha1_update(&ctx, engine_id, sizeof(engine_id));
+    sha1_update(&ctx, key, SHA1_DIGEST_LEN);
+    sha1_final(&ctx, key);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Initialize the security model.
+ */
+s8t usm_init()
+{
+#if ENABLE_USM_PRIVACY
+    u8t priv_key[SHA1_DIGEST_LEN];
+#endif /* ENABLE_USM_PRIVACY */
+#if CONTIKI_TARGET_AVR_RAVEN
+    usm_key_cache_t cache;
+    u8t tag[SHA1_DIGEST_LEN];
+    sha1_ctx_t ctx;
+
+    /* the erased EEPROM reads as -1 */
+    engine_boots = (s32t)eeprom_read_dword(&boots_cache);
+    if (engine_boots < 0) {
+        engine_boots = 0;
+    }
+    if (engine_boots < USM_MAX_INTEGER) {
+        engine_boots++;
+    }
+    eeprom_write_dword(&boots_cache, (uint32_t)engine_boots);
+
+    /* the keys are localized again only if a password or the engine ID have been changed */
+    sha1_init(&ctx);
+    sha1_update(&ctx, auth_password, sizeof(auth_password) - 1);
+#if ENABLE_USM_PRIVACY
+    sha1_update(&ctx, priv_password, sizeof(priv_password) - 1);
+#endif /* ENABLE_USM_PRIVACY */
+    sha1_update(&ctx, engine_id, sizeof(engine_id));
+    sha1_final(&ctx, tag);
+    eeprom_read_block(&cache, &key_cache, sizeof(usm_key_cache_t));
+    if (memcmp(cache.tag, tag, sizeof(cache.tag))) {
+        snmp_log("localizing the keys of the user\n");
+        usm_localize_key(auth_password, sizeof(auth_password) - 1, cache.auth_key);
+#if ENABLE_USM_PRIVACY
+        usm_localize_key(priv_password, sizeof(priv_password) - 1, priv_key);
+        memcpy(cache.priv_key, priv_key, AES_KEY_LEN);
+#endif /* ENABLE_USM_PRIVACY */
+        memcpy(cache.tag, tag, sizeof(cache.tag));
+        eeprom_write_block(&cache, &key_cache, sizeof(usm_key_cache_t));
+    }
+    memcpy(auth_key, cache.auth_key, SHA1_DIGEST_LEN);
+#if ENABLE_USM_PRIVACY
+    memcpy(priv_key, cache.priv_key, AES_KEY_LEN);
+#endif /* ENABLE_USM_PRIVACY */
+#else
+    /* there is no persistent storage */
+    engine_boots = 1;
+    usm_localize_key(auth_password, sizeof(auth_password) - 1, auth_key);
+#if ENABLE_USM_PRIVACY
+    usm_localize_key(priv_password, sizeof(priv_password) - 1, priv_key);
+#endif /* ENABLE_USM_PRIVACY */
+#endif /* CONTIKI_TARGET_AVR_RAVEN */
+#if ENABLE_USM_PRIVACY
+    /* the first 16 bytes of the localized key are the AES key (RFC 3826, 3.1.2.1) */
+    aes_init(&priv_ctx, priv_key);
+    salt_counter = 0;
+#endif /* ENABLE_USM_PRIVACY */
+    engine_time = 0;
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set the engine time.
+ */
+void usm_set_time(u32t seconds)
+{
+    engine_time = seconds & USM_MAX_INTEGER;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Compute HMAC-SHA-1 of a message with the authentication parameters taken as zeros,
+ * so the same function checks a request in place and signs a response which
+ * authentication parameters have been zeroed by the encoder.
+ */
+static void usm_hmac(const u8t* const data, const u16t len, const u16t auth_pos, u8t* digest)
+{
+    static const u8t zeros[SNMP_AUTH_PARAMS_LEN];
+    u8t pad[SHA1_BLOCK_LEN];
+    sha1_ctx_t ctx;
+    u8t i;
+
+    /* inner digest */
+    memset(pad, 0x36, SHA1_BLOCK_LEN);
+    for (i = 0; i < SHA1_DIGEST_LEN; i++) {
+        pad[i] ^= auth_key[i];
+    }
+    sha1_init(&ctx);
+    sha1_update(&ctx, pad, SHA1_BLOCK_LEN);
+    sha1_update(&ctx, data, auth_pos);
+    sha1_update(&ctx, zeros, SNMP_AUTH_PARAMS_LEN);
+    sha1_update(&ctx, data + auth_pos + SNMP_AUTH_PARAMS_LEN, len - auth_pos - SNMP_AUTH_PARAMS_LEN);
+    sha1_final(&ctx, digest);
+
+    /* outer digest */
+    memset(pad, 0x5C, SHA1_BLOCK_LEN);
+    for (i = 0; i < SHA1_DIGEST_LEN; i++) {
+        pad[i] ^= auth_key[i];
+    }
+    sha1_init(&ctx);
+    sha1_update(&ctx, pad, SHA1_BLOCK_LEN);
+    sha1_update(&ctx, digest, SHA1_DIGEST_LEN);
+    sha1_final(&ctx, digest);
+}
+
+#if ENABLE_USM_PRIVACY
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Build the initialization vector of a message from the engine boots, the engine time and the salt.
+ */
+static void usm_iv(u8t* iv, const s32t boots, const s32t time, const u8t* const salt)
+{
+    u8t i;
+    for (i = 0; i < 4; i++) {
+        iv[i] = (boots >> (8 * (3 - i))) & 0xFF;
+        iv[4 + i] = (time >> (8 * (3 - i))) & 0xFF;
+    }
+    memcpy(iv + 8, salt, USM_SALT_LEN);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Decrypt the scoped PDU of the request in place and decode it.
+ */
+static s8t usm_decrypt(u8t* input, const u16t input_len, message_t* message)
+{
+    u8t iv[AES_BLOCK_LEN];
+    if (message->v3.priv_params_len != USM_SALT_LEN) {
+        return -1;
+    }
+    usm_iv(iv, message->v3.engine_boots, message->v3.engine_time, message->v3.priv_params);
+    aes_cfb(&priv_ctx, iv, input + message->v3.scoped_pdu_pos, input_len - message->v3.scoped_pdu_pos, 1);
+    return ber_decode_scoped_pdu(input, input_len, message);
+}
+#endif /* ENABLE_USM_PRIVACY */
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Set up the header of the reply with the given security level.
+ */
+static void usm_reply(message_t* message, const u8t flags)
+{
+    message->v3.msg_flags = flags;
+    message->v3.msg_max_size = MAX_BUF_SIZE;
+    message->v3.engine_id = engine_id;
+    message->v3.engine_id_len = sizeof(engine_id);
+    message->v3.engine_boots = engine_boots;
+    message->v3.engine_time = engine_time;
+    message->v3.priv_params_len = 0;
+#if ENABLE_USM_PRIVACY
+    if (flags & SNMP_MSG_FLAG_PRIV) {
+        /* every message is encrypted with a new salt (RFC 3826, 3.1.2.1) */
+        u8t i;
+        salt_counter = (salt_counter + 1) & 0xFFFFFFFFUL;
+        for (i = 0; i < 4; i++) {
+            salt[i] = (engine_boots >> (8 * (3 - i))) & 0xFF;
+            salt[4 + i] = (salt_counter >> (8 * (3 - i))) & 0xFF;
+        }
+        message->v3.priv_params = salt;
+        message->v3.priv_params_len = USM_SALT_LEN;
+    }
+#endif /* ENABLE_USM_PRIVACY */
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Count the failure and replace the request by a report of the counter, if the manager asked for one.
+ */
+static s8t usm_report(message_t* message, const u8t stat, const u8t flags)
+{
+    varbind_t* varbind = message->pdu.varbind_first_ptr;
+    usm_stats[stat - 1]++;
+    snmp_log("usmStats %d, request discarded\n", stat);
+    if (!(message->v3.msg_flags & SNMP_MSG_FLAG_REPORTABLE)) {
+        return -1;
+    }
+
+    /* the arena may be used up by the request, so its first variable binding is reused */
+    if (!varbind && !(varbind = varbind_list_append(0))) {
+        return -1;
+    }
+    report_oid.values[9] = stat;
+    varbind->oid_ptr = &report_oid;
+    varbind->value_type = BER_TYPE_COUNTER;
+    varbind->value.u_value = usm_stats[stat - 1];
+    varbind->encoded_ptr = 0;
+    varbind->next_ptr = 0;
+
+    message->pdu.request_type = BER_TYPE_SNMP_REPORT;
+    message->pdu.error_status = ERROR_STATUS_NO_ERROR;
+    message->pdu.error_index = 0;
+    message->pdu.varbind_first_ptr = varbind;
+    message->pdu.varbind_len = 1;
+
+    message->v3.context_engine_id = engine_id;
+    message->v3.context_engine_id_len = sizeof(engine_id);
+    message->v3.context_name_len = 0;
+    usm_reply(message, flags);
+    return USM_REPORT;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Process the security parameters of an incoming message (RFC 3414, 3.2).
+ */
+s8t usm_process_incoming(u8t* input, const u16t input_len, message_t* message)
+{
+    message_v3_t* v3 = &message->v3;
+    u8t digest[SHA1_DIGEST_LEN];
+    s32t delta;
+#if ENABLE_USM_PRIVACY
+    s8t ret;
+#endif /* ENABLE_USM_PRIVACY */
+
+    /* a request with an empty engine ID discovers it */
+    if (v3->engine_id_len != sizeof(engine_id) || memcmp(v3->engine_id, engine_id, sizeof(engine_id))) {
+        return usm_report(message, USM_STATS_UNKNOWN_ENGINE_IDS, 0);
+    }
+    if (v3->user_len != sizeof(user) - 1 || memcmp(v3->user, user, v3->user_len)) {
+        return usm_report(message, USM_STATS_UNKNOWN_USER_NAMES, 0);
+    }
+    /* the user has to be authenticated */
+    if (!(v3->msg_flags & SNMP_MSG_FLAG_AUTH) || (v3->msg_flags & SNMP_MSG_FLAG_PRIV & ~USM_SECURITY_FLAGS)) {
+        return usm_report(message, USM_STATS_UNSUPPORTED_SEC_LEVELS, 0);
+    }
+
+    /* the digest is checked in the input */
+    if (!v3->auth_params_pos) {
+        return usm_report(message, USM_STATS_WRONG_DIGESTS, 0);
+    }
+    usm_hmac(input, input_len, v3->auth_params_pos, digest);
+    if (memcmp(digest, input + v3->auth_params_pos, SNMP_AUTH_PARAMS_LEN)) {
+        return usm_report(message, USM_STATS_WRONG_DIGESTS, 0);
+    }
+
+    /* the report of an outdated message is authenticated, so the manager can trust the time in it */
+    delta = v3->engine_time - engine_time;
+    if (engine_boots == USM_MAX_INTEGER || v3->engine_boots != engine_boots ||
+            delta > USM_TIME_WINDOW || delta < -USM_TIME_WINDOW) {
+        return usm_report(message, USM_STATS_NOT_IN_TIME_WINDOWS, SNMP_MSG_FLAG_AUTH);
+    }
+
+    snmp_log("user authenticated\n");
+#if ENABLE_USM_PRIVACY
+    if (v3->msg_flags & SNMP_MSG_FLAG_PRIV) {
+        ret = usm_decrypt(input, input_len, message);
+        if (ret == -1) {
+            return usm_report(message, USM_STATS_DECRYPTION_ERRORS, 0);
+        } else if (ret == ERR_MEMORY_ALLOCATION) {
+            stats_memory_error();
+            message->pdu.error_status = ERROR_STATUS_GEN_ERR;
+        }
+    }
+#endif /* ENABLE_USM_PRIVACY */
+    /* the reply has the security level of the request */
+    usm_reply(message, v3->msg_flags & (SNMP_MSG_FLAG_AUTH | SNMP_MSG_FLAG_PRIV));
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/*
+ * Encrypt and authenticate an outgoing message in place.
+ */
+void usm_process_outgoing(u8t* output, const u16t output_len, const message_t* const message)
+{
+    u8t digest[SHA1_DIGEST_LEN];
+#if ENABLE_USM_PRIVACY
+    u8t iv[AES_BLOCK_LEN];
+    if (message->v3.msg_flags & SNMP_MSG_FLAG_PRIV) {
+        usm_iv(iv, message->v3.engine_boots, message->v3.engine_time, message->v3.priv_params);
+        aes_cfb(&priv_ctx, iv, output + message->v3.scoped_pdu_pos, output_len - message->v3.scoped_pdu_pos, 0);
+    }
+#endif /* ENABLE_USM_PRIVACY */
+    /* the digest covers the encrypted scoped PDU */
+    if (message->v3.auth_params_pos) {
+        usm_hmac(output, output_len, message->v3.auth_params_pos, digest);
+        memcpy(output + message->v3.auth_params_pos, digest, SNMP_AUTH_PARAMS_LEN);
+    }
+}
+
+#endif /* ENABLE_SNMPv3 */
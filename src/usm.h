@@ -0,0 +1,57 @@
+/* -----------------------------------------------------------------------------
+ * SNMP implementation for Contiki
+ *
+ * Copyright (C) 2010 Siarhei Kuryla
+ *
+ * This program is part of free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/**
+ * \file
+ *         User-based Security Model of SNMPv3 (RFC 3414)
+ * \author
+ *         Siarhei Kuryla <kurilo@gmail.com>
+ */
+
+#ifndef __USM_H__
+#define	__USM_H__
+
+#include "snmp.h"
+
+/* returned by usm_process_incoming when the request has been replaced by a report */
+#define USM_REPORT      1
+
+/*
+ * Localizes the key of the user to the engine, or reads it from the persistent storage,
+ * and increments the number of engine boots.
+ */
+s8t usm_init();
+
+/* Sets the number of seconds since the last engine boot. */
+void usm_set_time(u32t seconds);
+
+/*
+ * Checks the engine ID, the user, the security level, the digest and the timeliness of the request,
+ * then decrypts its scoped PDU in place and decodes it if privacy is used.
+ * Returns 0 if the request may be processed, USM_REPORT if it has been replaced by a report,
+ * and -1 if it has to be discarded. The header of the message is set up for the reply.
+ */
+s8t usm_process_incoming(u8t* input, const u16t input_len, message_t* message);
+
+/* Encrypts the scoped PDU of an encoded message and writes the digest into its authentication parameters. */
+void usm_process_outgoing(u8t* output, const u16t output_len, const message_t* const message);
+
+#endif	/* __USM_H__ */
@@ -20,107 +20,174 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils.h"
 #include "logging.h"
 
-s8t oid_cmp(oid_t*  oid1, oid_t* oid2) {
-    oid_item_t* oi1 = oid1->first_ptr;
-    oid_item_t* oi2 = oid2->first_ptr;
-    while (oi1 && oi2) {
-        if (oi1->value > oi2->value) {
-            return 1;
-        } else if (oi1->value < oi2->value) {
-            return -1;
-        }
-        oi1 = oi1->next_ptr;
-        oi2 = oi2->next_ptr;
+#define TRACE_FILE 8
+
+/*---------------------------------------------------------*/
+/*
+ *  Per-request memory.
+ *  Everything allocated while handling a request comes from a static arena,
+ *  which is large enough for VAR_BIND_LEN variable bindings with their OIDs
+ *  and Counter64 values and is reset at the end of the request.
+ *  A request which does not fit fails with ERR_MEMORY_ALLOCATION, so the
+ *  memory of the agent stays bounded. With ENABLE_ARENA_HEAP on the host
+ *  it falls back to the heap instead: once the arena is exhausted, the rest
+ *  of the request is allocated in blocks on the heap, which are freed when
+ *  the arena is released or reset.
+ */
+#define ARENA_ALIGN(size) (((size) + sizeof(u32t) - 1) & ~(sizeof(u32t) - 1))
+
+#define ARENA_SIZE (VAR_BIND_LEN * (ARENA_ALIGN(sizeof(varbind_t)) + ARENA_ALIGN(sizeof(oid_t)) + \
+                    ARENA_ALIGN(sizeof(u64t))))
+
+static union {
+    u32t    align;
+    void*   align_ptr;
+    u8t     buffer[ARENA_SIZE];
+} arena;
+
+static u16t arena_len = 0;
+
+/** \brief Heap block of a request which does not fit into the arena. */
+typedef union arena_block_t {
+    struct {
+        union arena_block_t*    next_ptr;
+        u16t                    size;
+    } header;
+    u32t                        align;
+} arena_block_t;
+
+/* the heap blocks, the last allocated first, their number and the bytes they hold */
+static arena_block_t* arena_blocks = 0;
+static u16t arena_blocks_len = 0;
+static u16t arena_heap_len = 0;
+
+/* the most a request has taken from the arena and the heap */
+static u16t arena_peak_len = 0;
+
+static void arena_update_peak()
+{
+    if (arena_len + arena_heap_len > arena_peak_len) {
+        arena_peak_len = arena_len + arena_heap_len;
     }
-    return 0;
 }
 
-/*---------------------------------------------------------*/
+#if ENABLE_ARENA_HEAP
 /*
- *  u8t list functions.
+ * Allocate a heap block, the arena stays full until it is released.
  */
-mib_object_list_t* mib_object_list_append(mib_object_list_t* ptr, mib_object_t* value)
+static void* arena_alloc_block(u16t size)
 {
-    mib_object_list_t* new_el_ptr = malloc(sizeof(mib_object_list_t));
-    if (!new_el_ptr) return 0;
+    arena_block_t* block = malloc(sizeof(arena_block_t) + size);
+    CHECK_PTR_U(block);
+    block->header.next_ptr = arena_blocks;
+    block->header.size = size;
+    arena_blocks = block;
+    arena_blocks_len++;
+    arena_heap_len += size;
+    arena_len = ARENA_SIZE;
+    arena_update_peak();
+    return block + 1;
+}
+#endif /* ENABLE_ARENA_HEAP */
 
-    new_el_ptr->next_ptr = 0;
-    new_el_ptr->value = value;
-    if (ptr) {
-        ptr->next_ptr = new_el_ptr;
+void* arena_alloc(u16t size)
+{
+    void* ptr;
+    size = ARENA_ALIGN(size);
+    if (arena_len + size > ARENA_SIZE) {
+#if ENABLE_ARENA_HEAP
+        if (!arena_blocks) {
+            snmp_log("the request arena is exhausted\n");
+        }
+        return arena_alloc_block(size);
+#else
+        snmp_log("the request arena is exhausted\n");
+        return 0;
+#endif /* ENABLE_ARENA_HEAP */
     }
-    return new_el_ptr;
+    ptr = &arena.buffer[arena_len];
+    arena_len += size;
+    arena_update_peak();
+    return ptr;
+}
+
+/*
+ * A mark above ARENA_SIZE counts the heap blocks allocated before it.
+ */
+u16t arena_mark()
+{
+    return arena_len + arena_blocks_len;
 }
 
-void mib_object_list_free(mib_object_list_t* ptr)
+void arena_release(u16t mark)
 {
-    while (ptr) {
-        mib_object_list_t* next = ptr->next_ptr;
-        free(ptr);
-        ptr = next;
+    u16t blocks_len = mark > ARENA_SIZE ? mark - ARENA_SIZE : 0;
+    arena_block_t* block;
+    while (arena_blocks_len > blocks_len) {
+        block = arena_blocks;
+        arena_blocks = block->header.next_ptr;
+        arena_blocks_len--;
+        arena_heap_len -= block->header.size;
+        free(block);
     }
+    arena_len = mark - blocks_len;
+}
+
+void arena_reset()
+{
+    arena_release(0);
+}
+
+u16t arena_peak()
+{
+    return arena_peak_len;
 }
 
-/*---------------------------------------------------------*/
 /*
- *  Variable binding list functions.
+ *  Compare OIDs in the lexicographical order, a prefix precedes the longer OID.
  */
-varbind_t* varbind_list_append(varbind_t* ptr)
-{
-    varbind_t* new_el_ptr = malloc(sizeof(varbind_t));
-    if (!new_el_ptr) return 0;
-    new_el_ptr->next_ptr = 0;
-    if (ptr) {
-        ptr->next_ptr = new_el_ptr;
+s8t oid_cmp(const oid_t* const oid1, const oid_t* const oid2) {
+    u8t i, len = min(oid1->len, oid2->len);
+    for (i = 0; i < len; i++) {
+        if (oid1->values[i] > oid2->values[i]) {
+            return 1;
+        } else if (oid1->values[i] < oid2->values[i]) {
+            return -1;
+        }
     }
-    return new_el_ptr;
+    if (oid1->len > oid2->len) {
+        return 1;
+    } else if (oid1->len < oid2->len) {
+        return -1;
+    }
+    return 0;
 }
 
+u8t oid_starts_with(const oid_t* const oid, const oid_t* const prefix) {
+    return oid->len >= prefix->len && !memcmp(oid->values, prefix->values, prefix->len * sizeof(OID_T));
+}
 
 /*---------------------------------------------------------*/
 /*
- *  OID item list functions.
+ *  Variable binding list functions.
  */
-oid_item_t* oid_item_list_append(oid_item_t* ptr, OID_T value)
+varbind_t* varbind_list_append(varbind_t* ptr)
 {
-    oid_item_t* new_el_ptr = malloc(sizeof(oid_item_t));
+    varbind_t* new_el_ptr = arena_alloc(sizeof(varbind_t));
     if (!new_el_ptr) return 0;
+    new_el_ptr->encoded_ptr = 0;
     new_el_ptr->next_ptr = 0;
-    new_el_ptr->value = value;
     if (ptr) {
         ptr->next_ptr = new_el_ptr;
     }
     return new_el_ptr;
 }
 
-oid_item_t* oid_item_list_reverse(oid_item_t* ptr)
-{
-    oid_item_t* next_ptr, *cur_ptr;
-    cur_ptr = ptr->next_ptr;
-    ptr->next_ptr = 0;
-    
-    while (cur_ptr) {
-        next_ptr = cur_ptr->next_ptr;
-        cur_ptr->next_ptr = ptr;
-        ptr = cur_ptr;
-        cur_ptr = next_ptr;
-    }
-    return ptr;
-}
-
-
-void oid_item_list_free(oid_item_t* ptr)
-{
-    while (ptr) {
-        oid_item_t* next = ptr->next_ptr;
-        free(ptr);
-        ptr = next;
-    }
-}
 
 /*---------------------------------------------------------*/
 /*
@@ -128,51 +195,27 @@ void oid_item_list_free(oid_item_t* ptr)
  */
 oid_t* oid_create()
 {
-    oid_t* new_el_ptr = malloc(sizeof(oid_t));
+    oid_t* new_el_ptr = arena_alloc(sizeof(oid_t));
     if (!new_el_ptr) return 0;
-    new_el_ptr->first_ptr = 0;
     new_el_ptr->len = 0;
     return new_el_ptr;
 }
 
-void oid_free(oid_t* ptr)
-{
-    if (ptr) {
-        oid_item_list_free(ptr->first_ptr);
-        free(ptr);
-    }
-}
-
-oid_t* oid_copy(oid_t* oid_ptr, oid_item_t** last_oid_item)
+void oid_copy(oid_t* dest_ptr, const oid_t* const src_ptr)
 {
-    oid_t* ret = oid_create();
-    if (!ret) { return 0;}
-    ret->len = oid_ptr->len;
-
-    oid_item_t *cur_ptr = oid_ptr->first_ptr,  *prev_ptr = 0;
-    while (cur_ptr) {
-        if (!ret->first_ptr) {
-            prev_ptr = ret->first_ptr = oid_item_list_append(0, cur_ptr->value);
-        } else {
-            prev_ptr = oid_item_list_append(prev_ptr, cur_ptr->value);
-        }
-        if (!prev_ptr) { return 0;}
-        cur_ptr = cur_ptr->next_ptr;
-    }
-    if (last_oid_item) {
-        *last_oid_item = prev_ptr;
-    }
-    return ret;
+    dest_ptr->len = src_ptr->len;
+    memcpy(dest_ptr->values, src_ptr->values, src_ptr->len * sizeof(OID_T));
 }
 
-u8t oid_length(oid_item_t* ptr)
+s8t oid_append(oid_t* oid_ptr, const OID_T* const values, const u8t len)
 {
-    u8t ret = 0;
-    while (ptr) {
-        ret++;
-        ptr = ptr->next_ptr;
+    if (oid_ptr->len + len > OID_LEN) {
+        snmp_log("oid is longer than %d elements\n", OID_LEN);
+        return -1;
     }
-    return ret;
+    memcpy(&oid_ptr->values[oid_ptr->len], values, len * sizeof(OID_T));
+    oid_ptr->len += len;
+    return 0;
 }
 
 /*---------------------------------------------------------*/
@@ -183,6 +226,6 @@ mib_object_t* mib_object_create()
 {
     mib_object_t* new_el_ptr = malloc(sizeof(mib_object_t));
     if (!new_el_ptr) return 0;
-    new_el_ptr->next_ptr = 0;
+    memset(new_el_ptr, 0, sizeof(mib_object_t));
     return new_el_ptr;
 }
@@ -38,33 +38,28 @@
 #define CHECK_PTR(ptr) if (!ptr) { snmp_log("can not allocate memory, line: %d\n", __LINE__); return -1; }
 #define CHECK_PTR_U(ptr) if (!ptr) { snmp_log("can not allocate memory, line: %d\n", __LINE__); return 0; }
 
-s8t oid_cmp(oid_t* oid1, oid_t* oid2);
+void* arena_alloc(u16t size);
 
-typedef struct mib_object_list_t
-{
-    struct mib_object_t         *value;
-    struct mib_object_list_t    *next_ptr;
-} mib_object_list_t;
+u16t arena_mark();
 
-mib_object_list_t* mib_object_list_append(mib_object_list_t* ptr, mib_object_t* value);
+void arena_release(u16t mark);
 
-void mib_object_list_free(mib_object_list_t* ptr);
+void arena_reset();
 
-varbind_t* varbind_list_append(varbind_t* ptr);
+/* the most bytes of the arena and its heap blocks a request has taken */
+u16t arena_peak();
 
-oid_item_t* oid_item_list_append(oid_item_t* ptr, OID_T value);
+s8t oid_cmp(const oid_t* const oid1, const oid_t* const oid2);
 
-oid_item_t* oid_item_list_reverse(oid_item_t* ptr);
+u8t oid_starts_with(const oid_t* const oid, const oid_t* const prefix);
 
-void oid_item_list_free(oid_item_t* ptr);
+varbind_t* varbind_list_append(varbind_t* ptr);
 
 oid_t* oid_create();
 
-void oid_free(oid_t* ptr);
-
-oid_t* oid_copy(oid_t* oid_ptr, oid_item_t** last_oid_item);
+void oid_copy(oid_t* dest_ptr, const oid_t* const src_ptr);
 
-u8t oid_length(oid_item_t* ptr);
+s8t oid_append(oid_t* oid_ptr, const OID_T* const values, const u8t len);
 
 mib_object_t* mib_object_create();
 
@@ -0,0 +1,327 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# SNMP implementation for Contiki
+#
+# Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+#
+# This program is part of free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+#
+"""Request case of the host programs.
+
+Runs the commands of a case file against the agents of the host build on the
+loopback and prints every command followed by the decoded datagrams it gets
+back, so the output can be compared with the expected one.
+
+Commands, one per line, '#' starts a comment:
+
+  agent [option...]           start snmpd-linux, the requests are sent to it
+  gateway                     start compact-gateway in front of the agent,
+                              the requests are sent through it
+  proxy [option...]           start snmp-proxy in front of the agent,
+                              the requests are sent through it
+  get|getnext|set <community> <oid>[=<type>:<value>]...
+                              send a v2c request, SET values are typed
+                              i (INTEGER), u (Gauge32) or s (STRING)
+  getbulk <community> <non-repeaters> <max-repetitions> <oid>...
+  v1 <request>                send the request as SNMPv1
+  response <community> <request-id>
+                              acknowledge an Inform, no reply is awaited
+  spoof <command>             send the request or the response from
+                              another port than the manager's one
+  raw <hex>                   send a datagram as it is, the reply is
+                              printed in hex
+  recv <ms>                   print the datagrams the manager receives
+                              within the time, such as Informs
+
+Usage: snmpcase.py case.in
+"""
+
+import os
+import select
+import shlex
+import socket
+import subprocess
+import sys
+import time
+
+HOST_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'host')
+
+AGENT_PORT = 16161
+FRONT_PORT = 16162
+MANAGER_PORT = 16163
+SPOOF_PORT = 16164
+
+REPLY_TIMEOUT = 1.0
+
+PDU_TYPES = {
+    'get': 0xa0, 'getnext': 0xa1, 'response': 0xa2, 'set': 0xa3, 'getbulk': 0xa5,
+}
+
+PDU_NAMES = {
+    0xa0: 'GetRequest', 0xa1: 'GetNextRequest', 0xa2: 'Response', 0xa3: 'SetRequest',
+    0xa5: 'GetBulkRequest', 0xa6: 'InformRequest', 0xa7: 'SNMPv2-Trap', 0xa8: 'Report',
+}
+
+ERRORS = [
+    'noError', 'tooBig', 'noSuchName', 'badValue', 'readOnly', 'genErr', 'noAccess',
+    'wrongType', 'wrongLength', 'wrongEncoding', 'wrongValue', 'noCreation',
+    'inconsistentValue', 'resourceUnavailable', 'commitFailed', 'undoFailed',
+    'authorizationError', 'notWritable', 'inconsistentName',
+]
+
+VALUE_NAMES = {
+    0x02: 'INTEGER', 0x04: 'STRING', 0x05: 'NULL', 0x06: 'OID', 0x40: 'IpAddress',
+    0x41: 'Counter32', 0x42: 'Gauge32', 0x43: 'Timeticks', 0x46: 'Counter64',
+    0x80: 'noSuchObject', 0x81: 'noSuchInstance', 0x82: 'endOfMibView',
+}
+
+VERSIONS = {0: 'v1', 1: 'v2c', 3: 'v3'}
+
+
+class CaseError(Exception):
+    pass
+
+
+def tlv(type_id, value):
+    if len(value) < 0x80:
+        return bytes([type_id, len(value)]) + value
+    if len(value) < 0x100:
+        return bytes([type_id, 0x81, len(value)]) + value
+    return bytes([type_id, 0x82, len(value) >> 8, len(value) & 0xFF]) + value
+
+
+def encode_integer(value, type_id=0x02):
+    data = value.to_bytes(9, 'big', signed=True)
+    while len(data) > 1 and (data[0], data[1] & 0x80) in ((0x00, 0), (0xFF, 0x80)):
+        data = data[1:]
+    return tlv(type_id, data)
+
+
+def encode_oid(text):
+    oid = [int(i) for i in text.strip('.').split('.')]
+    data = bytes([oid[0] * 40 + oid[1]])
+    for value in oid[2:]:
+        encoded = [value & 0x7F]
+        value >>= 7
+        while value:
+            encoded.insert(0, 0x80 | (value & 0x7F))
+            value >>= 7
+        data += bytes(encoded)
+    return tlv(0x06, data)
+
+
+def encode_value(text):
+    if not text:
+        return b'\x05\x00'
+    type_id, value = text.split(':', 1)
+    if type_id == 'i':
+        return encode_integer(int(value))
+    if type_id == 'u':
+        return encode_integer(int(value), 0x42)
+    if type_id == 's':
+        return tlv(0x04, value.encode())
+    raise CaseError('unknown value type %s' % type_id)
+
+
+def encode_request(version, pdu_type, request_id, community, args):
+    error_status = error_index = 0
+    if pdu_type == 0xa5:
+        error_status, error_index = int(args[0]), int(args[1])
+        args = args[2:]
+    var_binds = b''
+    for arg in args:
+        oid, _, value = arg.partition('=')
+        var_binds += tlv(0x30, encode_oid(oid) + encode_value(value))
+    pdu = tlv(pdu_type, encode_integer(request_id) + encode_integer(error_status) +
+              encode_integer(error_index) + tlv(0x30, var_binds))
+    return tlv(0x30, encode_integer(version) + tlv(0x04, community.encode()) + pdu)
+
+
+def decode_tlv(data, pos):
+    type_id, length = data[pos], data[pos + 1]
+    pos += 2
+    if length & 0x80:
+        size = length & 0x7F
+        length = int.from_bytes(data[pos:pos + size], 'big')
+        pos += size
+    return type_id, data[pos:pos + length], pos + length
+
+
+def decode_sequence(data):
+    items, pos = [], 0
+    while pos < len(data):
+        type_id, value, pos = decode_tlv(data, pos)
+        items.append((type_id, value))
+    return items
+
+
+def decode_oid(data):
+    oid, value = [data[0] // 40, data[0] % 40], 0
+    for byte in data[1:]:
+        value = (value << 7) | (byte & 0x7F)
+        if not byte & 0x80:
+            oid.append(value)
+            value = 0
+    return '.'.join(str(i) for i in oid)
+
+
+def format_value(type_id, value):
+    name = VALUE_NAMES.get(type_id, 'type 0x%02x' % type_id)
+    if type_id == 0x02:
+        return '%s: %d' % (name, int.from_bytes(value, 'big', signed=True))
+    if type_id in (0x41, 0x42, 0x43, 0x46):
+        return '%s: %d' % (name, int.from_bytes(value, 'big'))
+    if type_id == 0x04:
+        if all(0x20 <= byte < 0x7F for byte in value):
+            return '%s: "%s"' % (name, value.decode())
+        return '%s: %s' % (name, value.hex())
+    if type_id == 0x06:
+        return '%s: %s' % (name, decode_oid(value))
+    if value:
+        return '%s: %s' % (name, value.hex())
+    return name
+
+
+def format_message(data):
+    """Decode a community based message, others are printed in hex."""
+    try:
+        _, message, _ = decode_tlv(data, 0)
+        fields = decode_sequence(message)
+        version = int.from_bytes(fields[0][1], 'big')
+        if version == 3:
+            raise ValueError
+        pdu_type, pdu = fields[2]
+        request_id, error_status, error_index, var_binds = decode_sequence(pdu)
+        status = int.from_bytes(error_status[1], 'big')
+        lines = ['%s %s %s %d %s %d' % (
+            VERSIONS.get(version, version), fields[1][1].decode(), PDU_NAMES.get(pdu_type, hex(pdu_type)),
+            int.from_bytes(request_id[1], 'big', signed=True), ERRORS[status] if status < len(ERRORS) else status,
+            int.from_bytes(error_index[1], 'big'))]
+        for _, var_bind in decode_sequence(var_binds[1]):
+            (_, oid), (type_id, value) = decode_sequence(var_bind)
+            lines.append('  %s = %s' % (decode_oid(oid), format_value(type_id, value)))
+        return '\n'.join(lines)
+    except (ValueError, IndexError, UnicodeDecodeError):
+        return data.hex()
+
+
+class Case:
+
+    def __init__(self, out):
+        self.out = out
+        self.processes = []
+        self.port = AGENT_PORT
+        self.request_id = 0
+        self.manager = self.open_socket(MANAGER_PORT)
+        self.spoofer = self.open_socket(SPOOF_PORT)
+
+    @staticmethod
+    def open_socket(port):
+        sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+        sock.bind(('::1', port))
+        return sock
+
+    def start(self, program, args, port):
+        self.processes.append(subprocess.Popen([os.path.join(HOST_DIR, program)] + args,
+                                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL))
+        self.port = port
+        time.sleep(0.2)
+
+    def stop(self):
+        for process in self.processes:
+            process.kill()
+            process.wait()
+        self.manager.close()
+        self.spoofer.close()
+
+    def receive(self, sock, timeout):
+        """Return the next datagram the socket receives within the timeout, None if there is none."""
+        if not select.select([sock], [], [], timeout)[0]:
+            return None
+        return sock.recv(4096)
+
+    def send(self, data, sock, reply, raw=False):
+        sock.sendto(data, ('::1', self.port))
+        if not reply:
+            return
+        data = self.receive(sock, REPLY_TIMEOUT)
+        if data is None:
+            self.out.write('no response\n')
+        else:
+            self.out.write((data.hex() if raw else format_message(data)) + '\n')
+
+    def command(self, words):
+        sock = self.manager
+        if words[0] == 'spoof':
+            sock = self.spoofer
+            words = words[1:]
+        version = 1
+        if words[0] == 'v1':
+            version = 0
+            words = words[1:]
+        name, args = words[0], words[1:]
+
+        if name == 'agent':
+            self.start('snmpd-linux', ['-p', str(AGENT_PORT)] + args, AGENT_PORT)
+        elif name == 'gateway':
+            self.start('compact-gateway', ['-p', str(FRONT_PORT), '::1', str(AGENT_PORT)], FRONT_PORT)
+        elif name == 'proxy':
+            self.start('snmp-proxy', args + ['%d=::1/%d' % (FRONT_PORT, AGENT_PORT)], FRONT_PORT)
+        elif name == 'response':
+            self.send(encode_request(version, 0xa2, int(args[1]), args[0], []), sock, False)
+        elif name in PDU_TYPES:
+            self.request_id += 1
+            self.send(encode_request(version, PDU_TYPES[name], self.request_id, args[0], args[1:]), sock, True)
+        elif name == 'raw':
+            self.send(bytes.fromhex(''.join(args)), sock, True, True)
+        elif name == 'recv':
+            deadline = time.monotonic() + int(args[0]) / 1000.0
+            received = 0
+            while True:
+                data = self.receive(self.manager, max(deadline - time.monotonic(), 0))
+                if data is None:
+                    break
+                self.out.write(format_message(data) + '\n')
+                received += 1
+            if not received:
+                self.out.write('no datagram\n')
+        else:
+            raise CaseError('unknown command %s' % name)
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write('usage: %s case.in\n' % argv[0])
+        return 1
+    case = Case(sys.stdout)
+    try:
+        with open(argv[1]) as f:
+            for line in f:
+                line = line.split('#', 1)[0].strip()
+                if not line:
+                    continue
+                sys.stdout.write('> %s\n' % line)
+                case.command(shlex.split(line))
+                sys.stdout.flush()
+    except CaseError as e:
+        sys.stderr.write('%s: %s\n' % (argv[1], e))
+        return 1
+    finally:
+        case.stop()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
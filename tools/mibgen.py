@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# SNMP implementation for Contiki
+#
+# Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+#
+# This program is part of free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+#
+"""MIB compiler.
+
+Turns a MIB description (see src/mib.def) into a C source file holding the
+objects of the MIB sorted by their OIDs, the variable bindings of the constant
+scalars BER encoded in advance and a perfect hash of the scalars' OIDs used by
+GET requests. The OIDs, the encodings, the hash and the descriptor of the MIB
+are placed in the program memory (MIB_PROGMEM), the objects, which hold the
+values and the cached encodings, stay in RAM.
+
+Usage: mibgen.py mib.def mib-gen.c
+"""
+
+import shlex
+import sys
+
+OID_LEN = 15
+OID_T_MAX = 0xFFFF
+
+TYPES = {
+    'INTEGER': 0x02,
+    'OCTET_STRING': 0x04,
+    'COUNTER': 0x41,
+    'GAUGE': 0x42,
+    'TIME_TICKS': 0x43,
+    'COUNTER64': 0x46,
+}
+
+
+class MibError(Exception):
+    pass
+
+
+def parse_oid(text, line_no):
+    try:
+        oid = [int(x) for x in text.strip('.').split('.')]
+    except ValueError:
+        raise MibError('line %d: bad oid %s' % (line_no, text))
+    if len(oid) < 2 or len(oid) > OID_LEN or any(x < 0 or x > OID_T_MAX for x in oid):
+        raise MibError('line %d: oid %s does not fit into oid_t' % (line_no, text))
+    return oid
+
+
+def parse(lines):
+    """Read the objects of the MIB description."""
+    objects = []
+    for line_no, line in enumerate(lines, 1):
+        words = shlex.split(line, comments=True)
+        if not words:
+            continue
+        if words[0] not in ('scalar', 'table') or len(words) < 2:
+            raise MibError('line %d: expected scalar or table' % line_no)
+        obj = {'kind': words[0], 'oid': parse_oid(words[1], line_no), 'line': line_no,
+               'get': None, 'next': None, 'set': None, 'value': None}
+        args = words[2:]
+        if obj['kind'] == 'scalar':
+            if not args or args[0] not in TYPES:
+                raise MibError('line %d: expected one of %s' % (line_no, ', '.join(sorted(TYPES))))
+            obj['type'] = args.pop(0)
+        for arg in args:
+            key, sep, value = arg.partition('=')
+            if not sep or key not in ('value', 'get', 'next', 'set'):
+                raise MibError('line %d: bad attribute %s' % (line_no, arg))
+            obj[key] = value
+        if obj['kind'] == 'table' and (not obj['next'] or obj['value'] is not None):
+            raise MibError('line %d: a table needs a next function and has no value' % line_no)
+        if obj['kind'] == 'scalar' and obj['next']:
+            raise MibError('line %d: a scalar has no next function' % line_no)
+        objects.append(obj)
+
+    objects.sort(key=lambda o: o['oid'])
+    for a, b in zip(objects, objects[1:]):
+        if a['oid'] == b['oid'] or (a['kind'] == 'table' and b['oid'][:len(a['oid'])] == a['oid']):
+            raise MibError('line %d: oid overlaps the object at line %d' % (b['line'], a['line']))
+    return objects
+
+
+def value_bytes(obj):
+    """Encode the value of a scalar the way ber_encode_var_bind does."""
+    type_name, value = obj['type'], obj['value']
+    if type_name == 'OCTET_STRING':
+        return (value or '').encode('latin-1')
+    number = int(value or '0', 0)
+    if type_name == 'INTEGER':
+        if number < -2 ** 31 or number >= 2 ** 31:
+            raise MibError('line %d: integer out of range' % obj['line'])
+        size = 4 if number < -16777216 or number > 16777215 else \
+            3 if number < -32768 or number > 32767 else \
+            2 if number < -128 or number > 127 else 1
+        return (number & 0xFFFFFFFF).to_bytes(4, 'big')[4 - size:]
+    if type_name == 'COUNTER64':
+        if number < 0 or number >= 2 ** 64:
+            raise MibError('line %d: Counter64 out of range' % obj['line'])
+        # a zero byte is prepended if the most significant bit is set
+        return number.to_bytes(number.bit_length() // 8 + 1, 'big')
+    if number < 0 or number >= 2 ** 32:
+        raise MibError('line %d: unsigned integer out of range' % obj['line'])
+    return number.to_bytes(max(1, (number.bit_length() + 7) // 8), 'big')
+
+
+def tlv(type_id, value):
+    if len(value) > 0xFF:
+        length = bytes([0x82, len(value) >> 8, len(value) & 0xFF])
+    elif len(value) > 0x7F:
+        length = bytes([0x81, len(value)])
+    else:
+        length = bytes([len(value)])
+    return bytes([type_id]) + length + value
+
+
+def encode_oid(oid):
+    out = bytearray([oid[0] * 40 + oid[1]])
+    for el in oid[2:]:
+        chunk = [el & 0x7F]
+        el >>= 7
+        while el:
+            chunk.append((el & 0x7F) | 0x80)
+            el >>= 7
+        out.extend(reversed(chunk))
+    return bytes(out)
+
+
+def encode_var_bind(obj):
+    return tlv(0x30, tlv(0x06, encode_oid(obj['oid'])) + tlv(TYPES[obj['type']], value_bytes(obj)))
+
+
+def mib_hash(oid, seed):
+    """Same as mib_hash() in mib.c."""
+    h = seed
+    for el in oid:
+        h = (h * 31 + el) & 0xFFFF
+    return h
+
+
+def perfect_hash(oids):
+    """Find the smallest table and a seed mapping every oid to its own slot."""
+    size = max(1, len(oids))
+    while True:
+        for seed in range(1024):
+            slots = set(mib_hash(oid, seed) % size for oid in oids)
+            if len(slots) == len(oids):
+                return size, seed
+        size += 1
+
+
+def c_string(data):
+    return '"' + ''.join(c if 32 <= ord(c) < 127 and c not in '"\\' else '\\%03o' % ord(c)
+                         for c in data.decode('latin-1')) + '"'
+
+
+def c_bytes(data):
+    return ', '.join('0x%02x' % b for b in data)
+
+
+def generate(objects, source_name):
+    out = []
+    w = out.append
+    w('/*')
+    w(' * MIB generated by tools/mibgen.py from %s, do not edit.' % source_name)
+    w(' */')
+    w('#include "mib.h"')
+    w('#include "ber.h"')
+    w('')
+    w('#if MIB_GENERATED_LEN < %d' % len(objects))
+    w('#error "MIB_GENERATED_LEN in snmpd-conf.h is less than the %d generated objects"' % len(objects))
+    w('#endif')
+    w('')
+
+    functions = {}
+    for obj in objects:
+        for key in ('get', 'next', 'set'):
+            if obj[key]:
+                functions[obj[key]] = key
+    protos = {
+        'get': 's8t %s(mib_object_t* object, OID_T* oid, u8t len);',
+        'next': 's8t %s(mib_object_t* object, OID_T* oid, u8t* len, u8t max_len);',
+        'set': 's8t %s(mib_object_t* object, OID_T* oid, u8t len, u8t phase, u8t value_type, varbind_value_t value);',
+    }
+    for name in sorted(functions):
+        w(protos[functions[name]] % name)
+    w('')
+
+    for i, obj in enumerate(objects):
+        w('static const oid_t oid_%d MIB_PROGMEM = {{%s}, %d};' % (i, ', '.join(map(str, obj['oid'])), len(obj['oid'])))
+    w('')
+
+    # Counter64 values are kept out of the variable binding
+    for i, obj in enumerate(objects):
+        if obj['kind'] == 'scalar' and obj['type'] == 'COUNTER64':
+            w('static u64t value_%d = %dULL;' % (i, int(obj['value'] or '0', 0)))
+    w('')
+
+    for i, obj in enumerate(objects):
+        if obj['kind'] == 'scalar' and not obj['get']:
+            data = encode_var_bind(obj)
+            w('static const u8t encoded_%d[] MIB_PROGMEM = {%s};' % (i, c_bytes(data)))
+            obj['encoded'] = len(data)
+    w('')
+
+    w('static mib_object_t objects[] = {')
+    for i, obj in enumerate(objects):
+        w('    /* %s */' % '.'.join(map(str, obj['oid'])))
+        w('    {')
+        w('        .varbind = {')
+        w('            .oid_ptr = (oid_t*)&oid_%d,' % i)
+        if obj['kind'] == 'table':
+            w('            .value_type = BER_TYPE_NULL,')
+        else:
+            w('            .value_type = BER_TYPE_%s,' % obj['type'])
+            if obj['type'] == 'COUNTER64':
+                w('            .value.u64_value = &value_%d,' % i)
+            elif obj['value'] is not None:
+                if obj['type'] == 'OCTET_STRING':
+                    data = value_bytes(obj)
+                    w('            .value.s_value = {(u8t*)%s, %d},' % (c_string(data), len(data)))
+                elif obj['type'] == 'INTEGER':
+                    w('            .value.i_value = %s,' % int(obj['value'], 0))
+                else:
+                    w('            .value.u_value = %sUL,' % int(obj['value'], 0))
+            if 'encoded' in obj:
+                w('            .encoded_ptr = encoded_%d,' % i)
+                w('            .encoded_len = %d,' % obj['encoded'])
+                w('            .encoded_pgm = 1,')
+        w('        },')
+        for key, field in (('get', 'get_fnc_ptr'), ('next', 'get_next_oid_fnc_ptr'), ('set', 'set_fnc_ptr')):
+            if obj[key]:
+                w('        .%s = &%s,' % (field, obj[key]))
+        flags = []
+        if obj['kind'] == 'scalar' and obj['type'] == 'OCTET_STRING' and obj['value'] is not None:
+            flags.append('MIB_STATIC_VALUE')
+        if 'encoded' in obj:
+            flags.append('MIB_STATIC_ENCODING')
+        flags.append('MIB_PROGMEM_OID')
+        w('        .flags = %s,' % ' | '.join(flags))
+        w('    },')
+    w('};')
+    w('')
+
+    scalars = [i for i, obj in enumerate(objects) if obj['kind'] == 'scalar']
+    size, seed = perfect_hash([objects[i]['oid'] for i in scalars])
+    if len(objects) > 0xFF:
+        raise MibError('more than 255 objects do not fit into the hash')
+    slots = [0] * size
+    for i in scalars:
+        slots[mib_hash(objects[i]['oid'], seed) % size] = i + 1
+    w('/* perfect hash of the scalars\' OIDs, the index of the object plus one */')
+    w('static const u8t hash[] MIB_PROGMEM = {')
+    w('    %s' % ', '.join(map(str, slots)))
+    w('};')
+    w('')
+    w('const mib_static_t mib_generated MIB_PROGMEM = {')
+    w('    objects, %d,' % len(objects))
+    w('    hash, %d, %d' % (size, seed))
+    w('};')
+    return '\n'.join(out) + '\n'
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+    try:
+        with open(argv[1]) as f:
+            objects = parse(f)
+        code = generate(objects, argv[1].split('/')[-1])
+    except (MibError, ValueError) as e:
+        sys.stderr.write('%s: %s\n' % (argv[1], e))
+        return 1
+    with open(argv[2], 'w') as f:
+        f.write(code)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# SNMP implementation for Contiki
+#
+# Copyright (C) 2010 Siarhei Kuryla <kurilo@gmail.com>
+#
+# This program is part of free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+#
+"""Trace decoder.
+
+Turns the trace batches of the agent (see src/logging.h) back into the log
+messages. The format strings are taken from the log points in the sources,
+which are identified by TRACE_FILE of their file and their line. The batches
+are read from a file (written by snmpd-linux -t), from the standard input or,
+with -u, received on a UDP port (the mote sends them to TRACE_PORT).
+
+Usage: tracedump.py [-s srcdir] [-u port | file]
+"""
+
+import glob
+import os
+import re
+import socket
+import struct
+import sys
+
+TRACE_HEADER = ord('T')
+TRACE_HEADER_LEN = 5
+TRACE_FLAG_INFO = 0x80
+
+FILE_RE = re.compile(r'^#define\s+TRACE_FILE\s+(\d+)', re.M)
+DEFINE_RE = re.compile(r'^#define\s+(\w+)\(.*?\bsnmp_(?:log|info)\(', re.M)
+CALL_RE = re.compile(r'\bsnmp_(?:log|info)\(\s*((?:"(?:[^"\\]|\\.)*"\s*)+)')
+STRING_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+CONVERSION_RE = re.compile(r'%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l)?([diouxXcsp%])')
+
+
+class TraceError(Exception):
+    pass
+
+
+def unescape(text):
+    return text.encode('latin-1').decode('unicode_escape')
+
+
+def line_of(source, pos):
+    return source.count('\n', 0, pos) + 1
+
+
+def scan(srcdir):
+    """Map (file, line) of every log point to its format string."""
+    formats = {}
+    for path in sorted(glob.glob(os.path.join(srcdir, '*.c'))):
+        with open(path) as f:
+            source = f.read()
+        file_id = FILE_RE.search(source)
+        if not file_id:
+            continue
+        file_id = int(file_id.group(1))
+        name = os.path.basename(path)
+        for m in CALL_RE.finditer(source):
+            fmt = ''.join(unescape(s) for s in STRING_RE.findall(m.group(1)))
+            # a call spanning several lines records the line its arguments end at
+            for line in range(line_of(source, m.start()), line_of(source, m.end()) + 2):
+                formats.setdefault((file_id, line), (name, fmt))
+        # a macro log point records the line the macro is used at
+        for m in DEFINE_RE.finditer(source):
+            fmt = formats.get((file_id, line_of(source, m.start())), (name, None))[1]
+            for use in re.finditer(r'\b%s\(' % m.group(1), source):
+                formats.setdefault((file_id, line_of(source, use.start())), (name, fmt))
+    return formats
+
+
+def render(fmt, args):
+    """Format the message the way printf would with the recorded arguments."""
+    args = list(args)
+
+    def arg():
+        return args.pop(0) if args else 0
+
+    def convert(m):
+        flags, width, precision, _, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if width == '*':
+            width = str(arg())
+        if precision == '*':
+            precision = str(arg())
+        spec = '%' + flags + width + ('.' + precision if precision is not None else '')
+        value = arg()
+        if conv == 's':
+            return (spec + 's') % '?'
+        if conv == 'c':
+            return (spec + 'c') % chr(value & 0xFF)
+        if conv in 'ouxXp':
+            return (spec + ('x' if conv == 'p' else conv)) % (value & 0xFFFFFFFF)
+        return (spec + 'd') % value
+    return CONVERSION_RE.sub(convert, fmt)
+
+
+def records(batch):
+    """Yield (file, line, flags, args) of the records of a batch."""
+    if len(batch) < TRACE_HEADER_LEN or batch[0] != TRACE_HEADER:
+        raise TraceError('bad batch header')
+    lost, length = struct.unpack('>HH', batch[1:TRACE_HEADER_LEN])
+    if lost:
+        yield None, lost, 0, ()
+    pos, end = TRACE_HEADER_LEN, TRACE_HEADER_LEN + length
+    if end > len(batch):
+        raise TraceError('truncated batch')
+    while pos < end:
+        file_id, line, flags = struct.unpack('>BHB', batch[pos:pos + 4])
+        count = flags & 0x03
+        args = struct.unpack('>%di' % count, batch[pos + 4:pos + 4 + 4 * count])
+        yield file_id, line, flags, args
+        pos += 4 + 4 * count
+
+
+def dump(batch, formats, out):
+    for file_id, line, flags, args in records(batch):
+        if file_id is None:
+            out.write('-- %d records lost\n' % line)
+            continue
+        name, fmt = formats.get((file_id, line), ('file %d' % file_id, None))
+        if fmt is None:
+            text = 'unknown log point, arguments: %s\n' % ' '.join(map(str, args))
+        else:
+            text = render(fmt, args)
+            if not text.endswith('\n'):
+                text += '\n'
+        out.write('%s:%d: %s%s' % (name, line, 'info: ' if flags & TRACE_FLAG_INFO else '', text))
+
+
+def batches(data):
+    """Split the contents of a trace file into the batches."""
+    pos = 0
+    while pos < len(data):
+        if len(data) - pos < TRACE_HEADER_LEN:
+            raise TraceError('truncated batch')
+        length = struct.unpack('>H', data[pos + 3:pos + TRACE_HEADER_LEN])[0]
+        yield data[pos:pos + TRACE_HEADER_LEN + length]
+        pos += TRACE_HEADER_LEN + length
+
+
+def main(argv):
+    srcdir = os.path.join(os.path.dirname(os.path.abspath(argv[0])), '..', 'src')
+    port = None
+    args = argv[1:]
+    try:
+        while args and args[0] in ('-s', '-u'):
+            if args[0] == '-s':
+                srcdir = args[1]
+            else:
+                port = int(args[1])
+            args = args[2:]
+    except (IndexError, ValueError):
+        args = None
+    if args is None or len(args) > 1 or (port is not None and args):
+        sys.stderr.write(__doc__)
+        return 1
+
+    formats = scan(srcdir)
+    try:
+        if port is not None:
+            sock = socket.socket(socket.AF_INET6, socket.SOCK_DGRAM)
+            sock.bind(('::', port))
+            while True:
+                dump(sock.recv(65535), formats, sys.stdout)
+                sys.stdout.flush()
+        if args:
+            with open(args[0], 'rb') as f:
+                data = f.read()
+        else:
+            data = sys.stdin.buffer.read()
+        for batch in batches(data):
+            dump(batch, formats, sys.stdout)
+    except TraceError as e:
+        sys.stderr.write('%s\n' % e)
+        return 1
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))